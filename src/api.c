@@ -3,53 +3,24 @@ LOG_MODULE_REGISTER(api, LOG_LEVEL_INF);
 
 #include <stdarg.h>
 #include <zephyr/kernel.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
 #include "stm32f7xx_remote_io.h"
-#include "system_info.h"
 #include "api.h"
+#include "api_commands.h"
 #include "uart.h"
-#include "digital_input.h"
-#include "digital_output.h"
-#include "settings.h"
-#include "flash.h"
-
-#ifdef CONFIG_REMOTEIO_USE_MY_WS28XX
-#include "ws28xx_pwm.h"
-#else
-#include "ws28xx_led.h"
-#endif
-
-#define PARAM_STR_MAX_LENGTH    MAX_INT_DIGITS+2 // 1 for sign, 1 for null terminator
-
-// run through the linked list of tokens and copy the data to the buffer
-#define API_COPY_TOKEN_DATA_TO_BUFFER(token, buffer, length) \
-    do { \
-        token_t *t = token; \
-        for (uint8_t i = 0; i < length; i++) { \
-            if (t == NULL) { \
-                error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER; \
-                break; \
-            } \
-            buffer[i] = t->i32; \
-            t = t->next; \
-        } \
-    } while (0); \
-    if (error_code) break
-
 
 // function prototypes
-token_t* api_create_token();
-void api_free_tokens(token_t* token);
-void api_reset_command_line();
-io_status_t api_process_data(api_service_context_t *service, command_line_t *command_line);
+token_t* api_create_token(command_line_t *command_line);
+void api_reset_command_line(command_line_t *command_line);
+void api_reset_parser(api_service_context_t *service);
+static uint32_t api_parse(api_service_context_t *service, const uint8_t *data, uint32_t length, bool *complete);
 void api_execute_command(api_service_context_t *service, command_line_t *command_line);
-void api_error(api_service_context_t *service, uint16_t error_code);
 static void api_uart_cb(void *user_data, void *data, uint8_t length, uint8_t uart_index);
 
 // event for receiving new data
 K_EVENT_DEFINE(apiNewDataEvent);
 
-static char anyTypeBuffer[UART_TX_BUFFER_SIZE] = {'\0'}; // store data for ANY type
-
 
 void api_task(void *p1, void *p2, void *p3)
 {
@@ -66,69 +37,66 @@ void api_task(void *p1, void *p2, void *p3)
         uart_listener_callback_set(i, &api_uart_cb, (void *)service);
     }
 
-    command_line_t command_line = {0}; // store command line data
+    // a new connection starts with an empty command line
+    api_reset_parser(service);
 
-    for (;;)
+    // run until the transport asks to quit, so the task never ends while it holds the tx buffer lock
+    while (!atomic_get(&service->quit))
     {
+        const uint8_t *data;
+        uint32_t length = utils_ring_read_span(service->rx_buffer, &data);
+
         // check if rx buffer is empty
-        if (utils_is_buffer_empty(service->rx_buffer) == STATUS_OK)
+        if (length == 0)
         {
-            // wait for new data event
-            k_event_wait(&apiNewDataEvent, service->event, true, K_FOREVER);
+            // clear the event before checking again, so data or notifications arriving meanwhile are not missed
+            k_event_clear(&apiNewDataEvent, service->event);
+            // add the notifications queued for this connection
+            api_send_notifications(service);
+            // the received batch is drained, send all its responses at once
+            service->flush_cb(service->user_data);
+            // the quit flag is set before the event is posted, so it is seen here if the event was cleared
+            if (utils_ring_is_empty(service->rx_buffer) && !atomic_get(&service->quit))
+            {
+                // wait for new data event
+                k_event_wait(&apiNewDataEvent, service->event, false, K_FOREVER);
+            }
+            continue;
         }
 
-        if (api_process_data(service, &command_line) == STATUS_OK)
+        // parse the received bytes, the parser stops at the end of a command
+        bool complete = false;
+        utils_ring_consume(service->rx_buffer, api_parse(service, data, length, &complete));
+        // let the transport receive again if it stopped on a full rx buffer
+        if (service->rx_resume_cb != NULL)
         {
-            // execute the command
-            api_execute_command(service, &command_line);
-            LOG_DBG("Command executed: %c%d.%d\n", command_line.type, command_line.id, command_line.variant);
+            service->rx_resume_cb(service->user_data);
         }
-        else
+
+        if (complete)
         {
-            while (service->rx_buffer->head != service->rx_buffer->tail)
-            {
-                char chr = service->rx_buffer->buffer[service->rx_buffer->tail];
-                // increment rx buffer tail
-                utils_increment_buffer_tail(service->rx_buffer);
-                if (chr == '\n' || chr == '\r')
-                {
-                    break;
-                }
-            }
+            command_line_t *command_line = &service->parser.command_line;
+            // execute the command
+            api_execute_command(service, command_line);
+            LOG_DBG("Command executed: %c%d.%d\n", command_line->type, command_line->id, command_line->variant);
+            // clear the command line and release its tokens
+            api_reset_parser(service);
         }
-
-        // free linked list of tokens
-        api_free_tokens(command_line.token);
-        // clear the command line
-        api_reset_command_line(&command_line);
     }
 }
 
-
-// increment rx buffer tail or wait for new data
-void api_increment_rx_buffer_tail_or_wait(utils_ring_buffer_t *ring_buf, uint32_t event)
-{
-    uint8_t nextTail = (ring_buf->tail + 1) % ring_buf->size; // next tail index
-    if (nextTail == ring_buf->head)
-    {
-        // wait for new data
-        k_event_wait(&apiNewDataEvent, event, true, K_FOREVER);
-    }
-    // increment rx buffer tail
-    utils_increment_buffer_tail(ring_buf);
-}
-
 // functions for tokenizing data
-// create token
-token_t* api_create_token()
+// take a token from the token pool of the command line
+token_t* api_create_token(command_line_t *command_line)
 {
-    // create token
-    token_t* token = (token_t*)malloc(sizeof(token_t));
-    if (token == NULL)
+    // check if there is any token left in the pool
+    if (command_line->token_count >= API_MAX_TOKENS)
     {
         return NULL;
     }
 
+    token_t* token = &command_line->token_pool[command_line->token_count++];
+
     // initialize token
     token->type = 0;
     token->value_type = 0;
@@ -138,1023 +106,846 @@ token_t* api_create_token()
     return token;
 }
 
-// free linked list of tokens
-void api_free_tokens(token_t* token)
+// reset command line
+// note: the token pool is not cleared, tokens are initialized when they are taken.
+void api_reset_command_line(command_line_t *command_line)
 {
-    token_t* next = NULL;
-    while (token != NULL)
-    {
-        next = token->next;
-        token->next = NULL;
-        free(token);
-        token = next;
-    }
+    command_line->type = 0;
+    command_line->id = 0;
+    command_line->variant = 0;
+    command_line->token = NULL;
+    command_line->last_token = NULL;
+    command_line->token_count = 0;
 }
 
-// reset command line
-void api_reset_command_line(command_line_t *command_line)
+// reset the parser to wait for the next command of the current protocol
+void api_reset_parser(api_service_context_t *service)
+{
+    api_parser_t *parser = &service->parser;
+
+    parser->state = (service->protocol == API_PROTOCOL_BINARY) ? API_PARSER_STATE_FRAME_SYNC : API_PARSER_STATE_TYPE;
+    parser->param_length = 0;
+    parser->is_decimal = false;
+    parser->received = 0;
+    parser->remaining = 0;
+    api_reset_command_line(&parser->command_line);
+}
+
+// report an error and drop the command line
+static void api_parse_fail(api_service_context_t *service, uint16_t error_code, char chr)
 {
-    memset(command_line, 0, sizeof(command_line_t));
+    api_error(service, error_code);
+    api_reset_parser(service);
+
+    // skip the rest of the line, unless the error is detected at its end
+    if (service->protocol == API_PROTOCOL_TEXT && chr != '\r' && chr != '\n')
+    {
+        service->parser.state = API_PARSER_STATE_DISCARD;
+    }
 }
 
-// parse received data
-io_status_t api_process_data(api_service_context_t *service, command_line_t *command_line)
+// take a token from the pool and append it to the command line
+static token_t *api_parse_add_token(api_service_context_t *service, uint8_t type, uint8_t value_type)
 {
-    utils_ring_buffer_t *rx_buf = service->rx_buffer; // rx buffer
-    char *rxBuffer = rx_buf->buffer; // buffer pointer
-    uint8_t rxBufferSize = rx_buf->size; // buffer size
-    char chr = rxBuffer[rx_buf->tail];          // current character
-    char param_str[PARAM_STR_MAX_LENGTH] = {'\0'};
-    bool isVariant = false;                     // check if there is a variant for the command
-    bool isLengthRequired = false;              // check if length is required for the command
+    command_line_t *command_line = &service->parser.command_line;
 
+    token_t *token = api_create_token(command_line);
+    if (token == NULL)
+    {
+        return NULL;
+    }
+    token->type = type;
+    token->value_type = value_type;
 
-    //// [Commnad Type]: lexing the command type //////////////////////////////////
-    // check if command type is valid
-    switch (chr)
+    // add token to the linked list
+    if (command_line->token == NULL)
     {
-    case 'W': case 'w': // write data
-        command_line->type = 'W';
-        break;
-    case 'R': case 'r': // read data
-        command_line->type = 'R';
-        break;
+        command_line->token = token;
+    }
+    else
+    {
+        command_line->last_token->next = token;
+    }
+    command_line->last_token = token;
 
-    case '\n': case '\r': // end of command
-        return STATUS_FAIL;
+    return token;
+}
 
-    default:
-        api_error(service, API_ERROR_CODE_INVALID_COMMAND_TYPE);
-        return STATUS_FAIL;
+// convert the lexed number into the last token, return false on error
+static bool api_parse_end_param(api_service_context_t *service, char chr)
+{
+    api_parser_t *parser = &service->parser;
+    token_t *token = parser->command_line.last_token;
+
+    parser->param_str[parser->param_length] = '\0';
+    if (parser->is_decimal)
+    {
+        token->value_type = PARAM_TYPE_FLOAT;
+        token->f = atof(parser->param_str);
+    }
+    else
+    {
+        token->i32 = atoi(parser->param_str);
     }
+    parser->param_length = 0;
+    parser->is_decimal = false;
 
-    // increment rx buffer tail
-    api_increment_rx_buffer_tail_or_wait(rx_buf, service->event);
+    // the raw data must fit in the buffer
+    if (token->type == TOKEN_TYPE_LENGTH && (token->value_type != PARAM_TYPE_INT32 ||
+        token->i32 <= 0 || token->i32 > API_DATA_MAX_LENGTH))
+    {
+        api_parse_fail(service, API_ERROR_CODE_INVALID_COMMAND_PARAMETER, chr);
+        return false;
+    }
 
+    return true;
+}
 
-    //// [ID].[Variant]: lexing the command id and variant ////////////////////////
-    while (rx_buf->head != rx_buf->tail)
+/**
+ * @brief   parse a character of the text protocol
+ *          format: "<R|W><ID>[.<Variant>] [<Param 1> ... <Param N>]\r\n"
+ *          commands carrying raw data: "W<ID>[.<Variant>] <Length> <Data>\r\n"
+ * @param   service  pointer to the service context
+ * @param   chr      received character
+ * @return  true if the command line is complete
+ */
+static bool api_parse_char(api_service_context_t *service, char chr)
+{
+    api_parser_t *parser = &service->parser;
+    command_line_t *command_line = &parser->command_line;
+    bool is_eol = (chr == '\r' || chr == '\n');
+
+    switch (parser->state)
     {
-        chr = rxBuffer[rx_buf->tail];
+    //// [Commnad Type]: lexing the command type //////////////////////////////////
+    case API_PARSER_STATE_TYPE:
+        switch (chr)
+        {
+        case 'W': case 'w': // write data
+            command_line->type = 'W';
+            parser->state = API_PARSER_STATE_ID;
+            break;
+        case 'R': case 'r': // read data
+            command_line->type = 'R';
+            parser->state = API_PARSER_STATE_ID;
+            break;
+        case '\n': case '\r': // empty line, or the end of the previous command line
+            break;
+        default:
+            api_parse_fail(service, API_ERROR_CODE_INVALID_COMMAND_TYPE, chr);
+            break;
+        }
+        return false;
 
+    //// [ID].[Variant]: lexing the command id and variant ////////////////////////
+    case API_PARSER_STATE_ID:
+    case API_PARSER_STATE_VARIANT:
+    {
+        bool is_variant = (parser->state == API_PARSER_STATE_VARIANT);
         if (chr >= '0' && chr <= '9')
         {
-            if (isVariant)
-            {
-                command_line->variant = command_line->variant * 10 + (chr - '0');
-            }
-            else
+            uint16_t *value = is_variant ? &command_line->variant : &command_line->id;
+            if (*value > (UINT16_MAX - (chr - '0')) / 10)
             {
-                command_line->id = command_line->id * 10 + (chr - '0');
+                api_parse_fail(service, is_variant ? API_ERROR_CODE_INVALID_COMMAND_VARIANT
+                                                   : API_ERROR_CODE_INVALID_COMMAND_ID, chr);
+                return false;
             }
+            *value = *value * 10 + (chr - '0');
         }
-        else if ((chr == '.') && (command_line->id != 0))
+        else if (chr == '.' && is_variant)
         {
-            if (!isVariant) isVariant = true;
-            else
-            {
-                api_error(service, API_ERROR_CODE_INVALID_COMMAND_VARIANT);
-                return STATUS_FAIL;
-            }
+            api_parse_fail(service, API_ERROR_CODE_INVALID_COMMAND_VARIANT, chr);
+        }
+        else if (chr == '.' && command_line->id != 0)
+        {
+            parser->state = API_PARSER_STATE_VARIANT;
         }
-        else if ((chr == ' ') && (command_line->id != 0))
+        else if (chr == ' ' && command_line->id != 0)
         {
-            if (isVariant && command_line->variant == 0) isVariant = false;
-            //remove all the blank spaces when processing the command
-            API_REMOVE_BLANK_SPACES(service);
             // proceed to next parsing step
-            break;
+            parser->state = API_PARSER_STATE_PARAM_START;
         }
-        else if ((chr == '\n' || chr == '\r') && command_line->id != 0)
+        else if (is_eol && command_line->id != 0)
         {
             // end of command line
-            return STATUS_OK;
+            return true;
         }
         else
         {
-            api_error(service, API_ERROR_CODE_INVALID_COMMAND_ID);
-            return STATUS_FAIL;
+            api_parse_fail(service, API_ERROR_CODE_INVALID_COMMAND_ID, chr);
         }
-
-        // increment rx buffer tail
-        api_increment_rx_buffer_tail_or_wait(rx_buf, service->event);
+        return false;
     }
 
-
     //// [Param]: lexing the parameters //////////////////////////////////////////
-    token_t* token = api_create_token();
-
-    // check if length parameter is required for the command
-    switch (command_line->id)
+    case API_PARSER_STATE_PARAM_START:
     {
-    case SERVICE_ID_SERIAL:
-        isLengthRequired = true;
-        break;
-    }
-
-    // check if first character is a digit or a sign
-    chr = rxBuffer[rx_buf->tail];
-    if (!isdigit(chr) && chr != '-')
-    {
-        api_error(service, API_ERROR_CODE_INVALID_COMMAND_PARAMETER);
-        api_free_tokens(token);
-        return STATUS_FAIL;
-    }
-    else
-    {
-        if (token == NULL)
+        // raw data follows the single blank space after its length, its own blank spaces are kept
+        token_t *last_token = command_line->last_token;
+        if (last_token != NULL && last_token->type == TOKEN_TYPE_LENGTH)
         {
-            api_error(service, API_ERROR_CODE_FAIL_ALLOCATE_MEMORY_FOR_TOKEN);
-            return STATUS_FAIL;
+            token_t *token = api_parse_add_token(service, TOKEN_TYPE_PARAM, PARAM_TYPE_ANY);
+            if (token == NULL)
+            {
+                api_parse_fail(service, API_ERROR_CODE_FAIL_ALLOCATE_MEMORY_FOR_TOKEN, chr);
+                return false;
+            }
+            token->any = parser->payload;
+            parser->payload[0] = chr;
+            parser->received = 1;
+            parser->remaining = last_token->i32 - 1;
+            parser->state = (parser->remaining > 0) ? API_PARSER_STATE_ANY : API_PARSER_STATE_ANY_END;
+            return false;
         }
 
-        // check if length is required for the command
-        if (isLengthRequired)
+        // remove all the blank spaces between the parameters
+        if (chr == ' ')
         {
-            token->type = TOKEN_TYPE_LENGTH;
+            return false;
         }
-        else
+
+        if (is_eol)
         {
-            token->type = TOKEN_TYPE_PARAM;
+            // end of command line
+            return true;
         }
 
-        token->value_type = PARAM_TYPE_INT32;
+        // check if first character is a digit or a sign
+        if (!isdigit((unsigned char)chr) && chr != '-')
+        {
+            api_parse_fail(service, API_ERROR_CODE_INVALID_COMMAND_PARAMETER, chr);
+            return false;
+        }
 
-        // add token to the linked list
-        command_line->token = token;
-        command_line->last_token = token;
+        // the first parameter of a command carrying raw data is the length of the data
+        const api_command_t *command = api_command_get(command_line->id);
+        bool is_length = (command_line->token == NULL && command != NULL && command->param_type == PARAM_TYPE_ANY);
+        if (api_parse_add_token(service, is_length ? TOKEN_TYPE_LENGTH : TOKEN_TYPE_PARAM, PARAM_TYPE_INT32) == NULL)
+        {
+            api_parse_fail(service, API_ERROR_CODE_FAIL_ALLOCATE_MEMORY_FOR_TOKEN, chr);
+            return false;
+        }
+        parser->param_str[0] = chr;
+        parser->param_length = 1;
+        parser->is_decimal = false;
+        parser->state = API_PARSER_STATE_PARAM;
+        return false;
     }
 
-    uint8_t param_index = 0;
-    bool isDecimal = false;
-    bool isAParam = false;
-    bool isError = false;
-
-    while (rx_buf->head != rx_buf->tail)
-    {
-        chr = rxBuffer[rx_buf->tail];
-
-        // process data based on the value type of the parameter
-        // type of number
-        if (token->value_type == PARAM_TYPE_INT32)
+    case API_PARSER_STATE_PARAM:
+        if ((chr >= '0' && chr <= '9') || (chr == '.' && !parser->is_decimal))
         {
-            if (chr == '-' && param_index == 0)
-            {
-                param_str[param_index++] = chr;
-            }
-            else if (chr >= '0' && chr <= '9' && param_index < PARAM_STR_MAX_LENGTH)
+            // keep room for the null terminator
+            if (parser->param_length >= API_PARAM_STR_MAX_LENGTH - 1)
             {
-                param_str[param_index++] = chr;
+                api_parse_fail(service, API_ERROR_CODE_TOO_MANNY_DIGITS, chr);
+                return false;
             }
-            else if ((chr == ' ') && (param_index > 0))
-            {
-                // end of parameter
-                isAParam = true;
-            }
-            else if ((chr == '\r' || chr == '\n') && (token->type != TOKEN_TYPE_LENGTH) && (param_index > 0))
+            parser->is_decimal |= (chr == '.');
+            parser->param_str[parser->param_length++] = chr;
+            return false;
+        }
+        if (chr == ' ' || is_eol)
+        {
+            // end of parameter
+            if (!api_parse_end_param(service, chr))
             {
-                // end of parameter
-                isAParam = true;
+                return false;
             }
-            else if (chr == '.' && !isDecimal && param_index < PARAM_STR_MAX_LENGTH)
+            if (chr == ' ')
             {
-                param_str[param_index++] = chr;
-                isDecimal = true;
+                parser->state = API_PARSER_STATE_PARAM_START;
+                return false;
             }
-            else
+            // the length must be followed by the data
+            if (command_line->last_token->type == TOKEN_TYPE_LENGTH)
             {
-                if (param_index >= PARAM_STR_MAX_LENGTH)
-                {
-                    api_error(service, API_ERROR_CODE_TOO_MANNY_DIGITS);
-                }
-                else
-                {
-                    api_error(service, API_ERROR_CODE_INVALID_COMMAND_PARAMETER);
-                }
-                isError = true;
-                break;
+                api_parse_fail(service, API_ERROR_CODE_INVALID_COMMAND_PARAMETER, chr);
+                return false;
             }
+            // end of command line
+            return true;
         }
-        // ANY type, push any data into the parameter
-        else if (token->value_type == PARAM_TYPE_ANY)
+        api_parse_fail(service, API_ERROR_CODE_INVALID_COMMAND_PARAMETER, chr);
+        return false;
+
+    case API_PARSER_STATE_ANY_END:
+        // raw data must be followed by the end of line
+        if (is_eol)
         {
-            if (param_index < command_line->last_token->i32)
-            {
-                anyTypeBuffer[param_index++] = chr;
-            }
-            
-            // check if it is the end of the parameter based on the length
-            if (param_index >= command_line->last_token->i32)
-            {
-                // check if next character is a `\r` or `\n`
-                uint8_t nextTail = (rx_buf->tail+1) % rxBufferSize;
-                if (nextTail != rx_buf->head)
-                {
-                    char chr = rxBuffer[nextTail];
-                    if (chr == '\n' || chr == '\r')
-                    {
-                        // end of parameter
-                        isAParam = true;
-                    }
-                    else
-                    {
-                        api_error(service, API_ERROR_CODE_INVALID_COMMAND_PARAMETER);
-                        isError = true;
-                        break;
-                    }
-                }
-                else // wait for new data
-                {
-                    API_WAIT_UNTIL_BUFFER_NOT_EMPTY(service, &apiNewDataEvent);
-                }
-            }
+            return true;
         }
+        api_parse_fail(service, API_ERROR_CODE_INVALID_COMMAND_PARAMETER, chr);
+        return false;
 
-        // check if it is the end of the parameter
-        if (isAParam)
+    case API_PARSER_STATE_DISCARD:
+    default:
+        if (is_eol)
         {
-            // check if the parameter is a float
-            if (isDecimal)
-            {
-                token->value_type = PARAM_TYPE_FLOAT;
-                token->f = atof(param_str);
-            }
-            else if (token->value_type == PARAM_TYPE_INT32)
-            {
-                token->i32 = atoi(param_str);
-            }
-            else
-            {
-                token->any = &anyTypeBuffer;
-            }
+            parser->state = API_PARSER_STATE_TYPE;
+        }
+        return false;
+    }
+}
 
-            // reset parameters
-            memset(param_str, '\0', sizeof(param_str));
-            param_index = 0;
-            isDecimal = false;
-            isAParam = false;
-
-            // check if it is the end of the command line
-            // wait until rx buffer is not empty
-            API_WAIT_UNTIL_BUFFER_NOT_EMPTY(service, &apiNewDataEvent);
-
-            // increment rx buffer tail
-            api_increment_rx_buffer_tail_or_wait(rx_buf, service->event);
-            // remove all the blank spaces when processing the command
-            API_REMOVE_BLANK_SPACES(service);
-            chr = rxBuffer[rx_buf->tail];
-            if ((chr == '\n' || chr == '\r') && (token->type != TOKEN_TYPE_LENGTH))
-            {
-                // increment rx buffer tail
-                utils_increment_buffer_tail(rx_buf);
-                // end of command line
-                return STATUS_OK;
-            }
+// compute the crc of a frame, the crc field of the header is excluded
+static uint16_t api_frame_crc(const api_frame_header_t *header, const uint8_t *payload, uint16_t length)
+{
+    uint16_t crc = crc16_ccitt(0xffff, (const uint8_t *)header, offsetof(api_frame_header_t, crc));
+    return crc16_ccitt(crc, payload, length);
+}
 
-            // update the last token
-            command_line->last_token = token;
+// convert a completely received binary frame into the command line, return true on success
+static bool api_parse_frame(api_service_context_t *service)
+{
+    api_parser_t *parser = &service->parser;
+    command_line_t *command_line = &parser->command_line;
+    uint16_t length = sys_le16_to_cpu(parser->header.length);
 
-            // not the end of the command line. Create a new token.
-            token = api_create_token();
-            if (token == NULL)
-            {
-                api_error(service, API_ERROR_CODE_FAIL_ALLOCATE_MEMORY_FOR_TOKEN);
-                isError = true;
-                break;
-            }
+    // check if the frame is intact
+    if (api_frame_crc(&parser->header, parser->payload, length) != sys_le16_to_cpu(parser->header.crc))
+    {
+        api_parse_fail(service, API_ERROR_CODE_INVALID_FRAME_CRC, 0);
+        return false;
+    }
 
-            // add new token to the linked list
-            command_line->last_token->next = token;
+    command_line->type = (parser->header.flags & API_FRAME_FLAG_WRITE) ? 'W' : 'R';
+    command_line->id = sys_le16_to_cpu(parser->header.id);
+    command_line->variant = sys_le16_to_cpu(parser->header.variant);
 
-            // check if the type of the parameter is supposed to be any
-            if (command_line->last_token != NULL && command_line->last_token->type == TOKEN_TYPE_LENGTH)
-            {
-                token->value_type = PARAM_TYPE_ANY;
-            }
-            else
-            {
-                token->value_type = PARAM_TYPE_INT32;
-            }
-        }
-        else
+    // raw data, e.g. serial data, is carried as is, a length token is followed by an ANY token
+    const api_command_t *command = api_command_get(command_line->id);
+    if (command != NULL && command->param_type == PARAM_TYPE_ANY && command_line->type == 'W')
+    {
+        if (length == 0 || length > API_DATA_MAX_LENGTH)
         {
-            // increment rx buffer tail
-            api_increment_rx_buffer_tail_or_wait(rx_buf, service->event);
+            api_parse_fail(service, API_ERROR_CODE_INVALID_FRAME_LENGTH, 0);
+            return false;
         }
 
-    } // while loop
+        token_t *length_token = api_parse_add_token(service, TOKEN_TYPE_LENGTH, PARAM_TYPE_INT32);
+        token_t *data_token = api_parse_add_token(service, TOKEN_TYPE_PARAM, PARAM_TYPE_ANY);
+        if (length_token == NULL || data_token == NULL)
+        {
+            api_parse_fail(service, API_ERROR_CODE_FAIL_ALLOCATE_MEMORY_FOR_TOKEN, 0);
+            return false;
+        }
+        length_token->i32 = length;
+        // the data stays in the payload buffer of the connection
+        data_token->any = parser->payload;
+        return true;
+    }
 
-    // free linked list of tokens if there is an error
-    if (isError)
+    // other payloads are a list of int32 parameters
+    if (length % sizeof(int32_t) != 0)
     {
-        return STATUS_FAIL;
+        api_parse_fail(service, API_ERROR_CODE_INVALID_FRAME_LENGTH, 0);
+        return false;
     }
 
-    // should not reach here
-    api_error(service, API_ERROR_CODE_INVALID_COMMAND_PARAMETER);
-    return STATUS_FAIL;
-}
-
-static void api_callback(void *user_data, const char *format, void *p1, void *p2, void *p3)
-{
-    // check if the user data is valid
-    if (user_data == NULL)
+    for (uint16_t i = 0; i < length; i += sizeof(int32_t))
     {
-        return;
+        token_t *token = api_parse_add_token(service, TOKEN_TYPE_PARAM, PARAM_TYPE_INT32);
+        if (token == NULL)
+        {
+            api_parse_fail(service, API_ERROR_CODE_FAIL_ALLOCATE_MEMORY_FOR_TOKEN, 0);
+            return false;
+        }
+        token->i32 = (int32_t)sys_get_le32(&parser->payload[i]);
     }
 
-    // get the service
-    api_service_context_t *service = (api_service_context_t *)user_data;
-
-    service->response_cb(service->user_data, format, p1, p2, p3);
+    return true;
 }
 
-static void api_sub_input_cb(void *user_data, uint8_t index, bool state)
+// the received header is not a frame, hunt for the next sync byte from the byte after its sync byte on
+static void api_parse_resync(api_service_context_t *service)
 {
-    // check if the user data is valid
-    if (user_data == NULL)
+    api_parser_t *parser = &service->parser;
+    uint8_t *header = (uint8_t *)&parser->header;
+
+    api_reset_parser(service);
+    uint8_t *sync = memchr(header + 1, API_FRAME_SYNC, sizeof(api_frame_header_t) - 1);
+    if (sync == NULL)
     {
         return;
     }
-
-    // get the service
-    api_service_context_t *service = (api_service_context_t *)user_data;
-
-    // send the state to the client
-    service->response_cb(service->user_data, "S%d %d %d\r\n", SERVICE_ID_SUBSCRIBE_INPUT, index + 1, state);
+    parser->received = header + sizeof(api_frame_header_t) - sync;
+    memmove(header, sync, parser->received);
+    parser->state = API_PARSER_STATE_FRAME_HEADER;
 }
 
-static void api_uart_cb(void *user_data, void *data, uint8_t length, uint8_t uart_index)
+// the header of a binary frame has been received, return true if the frame is complete
+static bool api_parse_frame_header(api_service_context_t *service)
 {
-    api_service_context_t *service = (api_service_context_t *)user_data;
-    // check if the user data is valid
-    if (service == NULL)
-    {
-        return;
-    }
-    // check if the data is valid
-    if (data == NULL || length == 0)
+    api_parser_t *parser = &service->parser;
+    uint16_t length = sys_le16_to_cpu(parser->header.length);
+
+    // check if the payload fits in the frame buffer;
+    // the crc is only checked with the payload, so an oversized length is taken as a stray sync byte
+    // instead of skipping a payload which may hold the following frames
+    if (length > sizeof(parser->payload))
     {
-        return;
+        api_error(service, API_ERROR_CODE_INVALID_FRAME_LENGTH);
+        api_parse_resync(service);
+        return false;
     }
-    // check if the length is valid
-    if (length > UART_TX_BUFFER_SIZE)
+
+    parser->received = 0;
+    parser->remaining = length;
+
+    if (length == 0)
     {
-        length = UART_TX_BUFFER_SIZE;
+        return api_parse_frame(service);
     }
-    // create a tx buffer
-    uint8_t txBuffer[UART_TX_BUFFER_SIZE] = {'\0'};
-    sprintf(txBuffer, "R%d.%d ", SERVICE_ID_SERIAL, uart_index);
-    size_t txBuffIndex = strlen(txBuffer);
-    // copy the data to the tx buffer
-    memcpy(txBuffer + txBuffIndex, data, length);
-    // append new line
-    txBuffIndex += length;
-    txBuffer[txBuffIndex++] = '\r';
-    txBuffer[txBuffIndex++] = '\n';
-    // send the data to the client
-    service->response_cb_bytes(service->user_data, txBuffer, txBuffIndex);
+
+    parser->state = API_PARSER_STATE_FRAME_PAYLOAD;
+    return false;
 }
 
-// execute the command
-void api_execute_command(api_service_context_t *service, command_line_t *command_line)
+/**
+ * @brief   feed received bytes to the parser of the service
+ *          the parser keeps its state, so a command may be split over several feeds.
+ *          raw data and binary frames are copied in bulk.
+ * @param   service   pointer to the service context
+ * @param   data      contiguous received bytes
+ * @param   length    number of bytes
+ * @param   complete  set to true if a command line is complete, it must be executed
+ *                    and the parser reset before the next feed
+ * @return  number of bytes consumed, parsing stops at the end of a command line
+ */
+static uint32_t api_parse(api_service_context_t *service, const uint8_t *data, uint32_t length, bool *complete)
 {
-    uint16_t error_code = 0;
+    api_parser_t *parser = &service->parser;
+    uint32_t consumed = 0;
 
-    // execute the command
-    switch (command_line->id)
+    *complete = false;
+    while (consumed < length && !*complete)
     {
-    case SERVICE_ID_STATUS:
-        // execute status command
-        if (command_line->type == 'R')
-        {
-            // send default response
-            API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SERVICE_ID_SYSTEM_INFO:
-        // execute system info command
-        if (command_line->type == 'R')
-        {
-            // get system info
-            system_info_print( service, (system_info_callback_fn_t)&api_callback);
-        }   
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SERVICE_ID_SERIAL:
-        // execute serial command
-        if (command_line->type == 'W')
-        {
-            // search for the message token and ingore the length token
-            token_t* token = command_line->token;
-            uint8_t length = 0;
-            while (token != NULL)
-            {
-                if (token->type == TOKEN_TYPE_LENGTH)
-                {
-                    length = token->i32;
-                }
-                else if (token->value_type == PARAM_TYPE_ANY)
-                {
-                    break;
-                }
-                token = token->next;
-            }
-            // check if the token is found
-            if (token == NULL)
-            {
-                error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-            }
-            else
-            {
-                // ensure the index of uart is valid
-                if (command_line->variant >= UART_MAX)
-                {
-                    error_code = API_ERROR_CODE_INVALID_COMMAND_VARIANT;
-                    break;
-                }
-                // send the message to the serial port
-                uart_printf((uart_index_t)(command_line->variant), (uint8_t*)token->any, length);
-                // clear param buffer
-                memset(anyTypeBuffer, '\0', sizeof(anyTypeBuffer));
-                // reply with default response
-                API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-            }
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SERVICE_ID_INPUT:
-        // execute input command
-        if (command_line->type == 'R')
+        const uint8_t *ptr = data + consumed;
+        uint32_t available = length - consumed;
+        uint32_t count;
+
+        switch (parser->state)
         {
-            // check if parameter is valid
-            if (command_line->token == NULL ||
-                command_line->token->value_type != PARAM_TYPE_INT32 ||
-                command_line->token->i32 == 0 ||
-                command_line->token->i32 > DIGITAL_INPUT_MAX)
+        case API_PARSER_STATE_ANY:
+            // copy as much raw data as has been received
+            count = MIN(available, parser->remaining);
+            memcpy(&parser->payload[parser->received], ptr, count);
+            parser->received += count;
+            parser->remaining -= count;
+            if (parser->remaining == 0)
             {
-                error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                break;
+                parser->state = API_PARSER_STATE_ANY_END;
             }
+            break;
 
-            // if the parameter equals to -1, read all the digital inputs
-            if (command_line->token->i32 == -1)
-            {
-                // read all the digital inputs
-                uint32_t state = digital_input_read_all();
-                // send the state to the client, format: "R<Service ID> <State>"
-                service->response_cb(service->user_data, "R%d %d\r\n", SERVICE_ID_INPUT, state);
-            }
-            // read the state of specified digital input
-            else
-            {
-                bool state = digital_input_read((uint8_t)(command_line->token->i32 - 1));
-                // send the state to the client, format: "R<Service ID> <Input Index> <State>"
-                service->response_cb(service->user_data, "R%d %d %d\r\n", SERVICE_ID_INPUT, command_line->token->i32, state);
-            }
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SERVICE_ID_SUBSCRIBE_INPUT:
-        // execute subscribe input command
-        if (command_line->type == 'W')
+        case API_PARSER_STATE_FRAME_SYNC:
         {
-            // check if token is valid
-            if (command_line->token == NULL)
+            // hunt for the start of a frame
+            const uint8_t *sync = memchr(ptr, API_FRAME_SYNC, available);
+            if (sync == NULL)
             {
-                error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+                count = available;
                 break;
             }
+            count = sync - ptr + 1;
+            parser->header.sync = API_FRAME_SYNC;
+            parser->received = 1;
+            parser->state = API_PARSER_STATE_FRAME_HEADER;
+            break;
+        }
 
-            token_t* token = command_line->token;
-            while (token != NULL)
+        case API_PARSER_STATE_FRAME_HEADER:
+            count = MIN(available, sizeof(api_frame_header_t) - parser->received);
+            memcpy((uint8_t *)&parser->header + parser->received, ptr, count);
+            parser->received += count;
+            if (parser->received == sizeof(api_frame_header_t))
             {
-                // check if parameter is valid
-                if (token->value_type != PARAM_TYPE_INT32 ||
-                token->i32 == 0 ||
-                token->i32 > DIGITAL_INPUT_MAX)
-                {
-                    error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                    break;
-                }
-                // subscribe to the digital input
-                digital_input_subscribe(service, (token->i32 - 1), (digital_input_callback_fn_t)&api_sub_input_cb);
-                token = token->next;
+                *complete = api_parse_frame_header(service);
             }
-            API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else if (command_line->type == 'R')
-        {
-            // print header
-            service->response_cb(service->user_data, "R%d ", SERVICE_ID_SUBSCRIBE_INPUT);
-            // print current subscribed digital inputs
-            digital_input_print_subscribed_inputs(service, (digital_input_callback_fn_t)&api_callback);
-            // print new line
-            service->response_cb(service->user_data, "\r\n");
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SERVICE_ID_UNSUBSCRIBE_INPUT:
-        // execute unsubscribe input command
-        // check if token is valid
-        if (command_line->token == NULL)
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
             break;
-        }
 
-        if (command_line->type == 'W')
-        {
-            token_t* token = command_line->token;
-            while (token != NULL)
+        case API_PARSER_STATE_FRAME_PAYLOAD:
+            count = MIN(available, parser->remaining);
+            memcpy(&parser->payload[parser->received], ptr, count);
+            parser->received += count;
+            parser->remaining -= count;
+            if (parser->remaining == 0)
             {
-                // check if parameter is valid
-                if (token->value_type != PARAM_TYPE_INT32 ||
-                token->i32 == 0 ||
-                token->i32 > DIGITAL_INPUT_MAX)
-                {
-                    error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                    break;
-                }
-                // unsubscribe to the digital input
-                digital_input_unsubscribe(service, token->i32 - 1);
-                token = token->next;
+                *complete = api_parse_frame(service);
             }
-            API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SERVICE_ID_OUTPUT:
-    {
-        // check if token is valid
-        if (command_line->token == NULL)
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+            break;
+
+        default:
+            count = 1;
+            *complete = api_parse_char(service, (char)*ptr);
             break;
         }
 
-        token_t* token = command_line->token;
+        consumed += count;
+    }
 
-        // get output index
-        int16_t output_index = token->i32;
+    return consumed;
+}
 
-        // execute output command
-        if (command_line->type == 'W')
-        {
-            // handle different variants of the command
-            switch (command_line->variant)
-            {
-                case 1: // write to multiple outputs
-                {
-                    // get the write value
-                    if (token == NULL)
-                    {
-                        error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                        break;
-                    }
-                    uint32_t data = token->i32;
-
-                    // get the start index
-                    token = token->next;
-                    if (token == NULL)
-                    {
-                        error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                        break;
-                    }
-                    uint8_t start_index = (uint8_t)token->i32;
-
-                    // check if parameter is valid
-                    if (start_index == 0 || start_index > DIGITAL_OUTPUT_MAX)
-                    {
-                        error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                        break;
-                    }
-
-                    // get the length
-                    token = token->next;
-                    if (token == NULL)
-                    {
-                        error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                        break;
-                    }
-                    uint8_t length = (uint8_t)token->i32;
-
-                    // write to multiple digital outputs
-                    digital_output_write_multiple(data, start_index - 1, length);
-
-                    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-                    break;
-                }
-                default: // write to single output
-                {
-                    // check if parameter is valid
-                    if (output_index == 0 || output_index >= DIGITAL_OUTPUT_MAX)
-                    {
-                        error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                        break;
-                    }
-
-                    // get the write value
-                    token = token->next;
-                    if (token == NULL)
-                    {
-                        error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                        break;
-                    }
-                    bool state = (token->i32 > 0) ? true : false;
-
-                    // write to the digital output
-                    int ret = digital_output_write(output_index - 1, state);
-                    if (ret < 0)
-                    {
-                        error_code = API_ERROR_CODE_WRITE_DIGITAL_OUTPUT_FAILED;
-                        break;
-                    }
-
-                    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-                    break;
-                }
-            }
-        }
-        else if (command_line->type == 'R')
-        {
-            if (output_index == -1)
-            {
-                // read all the digital outputs
-                uint32_t state = digital_output_read_all();
-                // send the state to the client, format: "R<Service ID> <State>"
-                service->response_cb(service->user_data, "R%d %d\r\n", SERVICE_ID_OUTPUT, state);
-            }
-            else
-            {
-                // check if parameter is valid
-                if (output_index == 0 || output_index > DIGITAL_OUTPUT_MAX)
-                {
-                    error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                    break;
-                }
-                // read the state of specified digital output
-                bool state = digital_output_read((uint8_t)output_index - 1);
-                // send the state to the client, format: "R<Service ID> <Output Index> <State>"
-                service->response_cb(service->user_data, "R%d %d %d\r\n", SERVICE_ID_OUTPUT, output_index, state);
-            }
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
+/**
+ * @brief   reserve space for a part of the response being built
+ *          if the tx buffer runs out of space, the responses before the one being built are flushed
+ * @param   service  pointer to the service context
+ * @param   length   maximum number of bytes to be written
+ * @return  pointer to write to, or NULL if the response does not fit in the tx buffer
+ */
+static char *api_response_reserve(api_service_context_t *service, uint16_t length)
+{
+    api_tx_buffer_t *tx = service->tx_buffer;
+
+    if (length <= tx->size - tx->length)
+    {
+        return tx->buffer + tx->length;
     }
-    case SERVICE_ID_GPIO_WS28XX_LED:
+
+    // the response would not fit even in an empty buffer
+    uint16_t partial = tx->length - tx->response_start;
+    if (tx->response_start == 0 || length > tx->size - partial)
     {
-        // check if token is valid
-        if (command_line->token == NULL)
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-            break;
-        }
+        return NULL;
+    }
 
-        token_t* token = command_line->token;
+    // send the previous responses, then move the partial response to the front
+    // note: the tx buffer lock is recursive, so the flush callback may take it again
+    uint16_t start = tx->response_start;
+    tx->length = start;
+    service->flush_cb(service->user_data);
+    memmove(tx->buffer, tx->buffer + start, partial);
+    tx->response_start = 0;
+    tx->length = partial;
 
-        // get the LED index
-        uint16_t led_index = token->i32;
+    return tx->buffer + tx->length;
+}
 
-        // execute WS28XX LED command
-        if (command_line->type == 'W')
-        {
-            // get the color of the LED
-            token = token->next;
-            if (token == NULL)
-            {
-                error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                break;
-            }
+// start a binary frame in the tx buffer, the header is completed by api_response_end
+static void api_response_begin_frame(api_service_context_t *service, uint8_t flags, uint16_t id)
+{
+    api_tx_buffer_t *tx = service->tx_buffer;
 
-            // get the color of the LED
-            uint8_t r = (uint8_t)token->i32;
-            token = token->next;
-            if (token == NULL)
-            {
-                error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                break;
-            }
+    k_mutex_lock(&tx->lock, K_FOREVER);
+    tx->response_start = tx->length;
+    api_frame_header_t *header = (api_frame_header_t *)api_response_reserve(service, sizeof(api_frame_header_t));
+    if (header == NULL)
+    {
+        return;
+    }
+    header->sync = API_FRAME_SYNC;
+    header->flags = flags;
+    header->id = sys_cpu_to_le16(id);
+    header->variant = 0;
+    tx->length += sizeof(api_frame_header_t);
+}
 
-            uint8_t g = (uint8_t)token->i32;
-            token = token->next;
-            if (token == NULL)
-            {
-                error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                break;
-            }
+// start a text response "<Prefix><ID>" in the tx buffer, e.g. "R3" or "ERR204"
+static void api_response_begin_text(api_service_context_t *service, const char *prefix, uint16_t id)
+{
+    api_tx_buffer_t *tx = service->tx_buffer;
+    uint16_t length = strlen(prefix);
 
-            uint8_t b = (uint8_t)token->i32;
+    k_mutex_lock(&tx->lock, K_FOREVER);
+    tx->response_start = tx->length;
+    char *ptr = api_response_reserve(service, length + MAX_INT_DIGITS);
+    if (ptr == NULL)
+    {
+        return;
+    }
+    memcpy(ptr, prefix, length);
+    tx->length += length + utils_utoa(id, ptr + length);
+}
 
-            // set the color of the LED
-            if (ws28xx_led_set_color(r, g, b, led_index) != 0)
-            {
-                error_code = API_ERROR_CODE_SET_LED_COLOR_FAILED;
-                break;
-            }
-            else API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else if (command_line->type == 'R')
-        {
-            // read the color of the LED
-            uint8_t r = 0, g = 0, b = 0;
-            // get the color of the LED
-            if (ws28xx_led_get_color(&r, &g, &b, led_index) != 0)
-            {
-                error_code = API_ERROR_CODE_GET_LED_COLOR_FAILED;
-                break;
-            }
-            // send the color to the client, format: "R<Service ID> <LED Index> <R> <G> <B>"
-            service->response_cb(service->user_data, "R%d %d %d %d %d\r\n", SERVICE_ID_GPIO_WS28XX_LED, led_index, r, g, b);
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-            break;
-        }
-        break;
+/**
+ * @brief   start a response in the tx buffer of the service, the tx buffer stays locked until api_response_end
+ *          text format: "<Prefix><ID>", e.g. "R3"
+ *          binary format: a response frame, or a notification frame if the prefix is 'S'
+ * @param   service  pointer to the service context
+ * @param   prefix   'R' or 'W' for a response to a command, 'S' for a notification
+ * @param   id       service id or setting id
+ */
+void api_response_begin(api_service_context_t *service, char prefix, uint16_t id)
+{
+    if (service->protocol == API_PROTOCOL_BINARY)
+    {
+        api_response_begin_frame(service, (prefix == 'S') ? API_FRAME_FLAG_NOTIFY : API_FRAME_FLAG_RESPONSE, id);
+        return;
     }
-    case SETTING_ID_IP_ADDRESS:
-        if (command_line->type == 'R')
-        {
-            // send the IP address to the client, format: "R<Service ID> <IP Addr 1> <IP Addr 2> <IP Addr 3> <IP Addr 4>"
-            // e.g. "R101 172 16 0 10"
-            service->response_cb(service->user_data, "R%d %d %d %d %d\r\n", SETTING_ID_IP_ADDRESS,
-                        settings.ip_address_0, settings.ip_address_1,
-                        settings.ip_address_2, settings.ip_address_3);
-        }
-        else if (command_line->type == 'W')
-        {
-            uint8_t ip_address[4] = {0};
-            token_t* token = command_line->token;
-
-            // copy IP address from token to buffer
-            API_COPY_TOKEN_DATA_TO_BUFFER(token, ip_address, 4);
-            
-            // update the IP address in the settings
-            settings.ip_address_0 = ip_address[0];
-            settings.ip_address_1 = ip_address[1];
-            settings.ip_address_2 = ip_address[2];
-            settings.ip_address_3 = ip_address[3];
-
-            // save IP address in flash
-            if (flash_write_data_with_checksum(FLASH_SECTOR_SETTINGS, (uint8_t*)&settings, sizeof(settings_t)) != STATUS_OK)
-            {
-                error_code = API_ERROR_CODE_UPDATE_IP_FAILED;
-            }
-            else API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SETTING_ID_NETMASK:
-        if (command_line->type == 'R')
-        {
-            // send the netmask to the client, format: "R<Service ID> <Netmask 1> <Netmask 2> <Netmask 3> <Netmask 4>"
-            // e.g. "R102 255 240 0 0"
-            service->response_cb(service->user_data, "R%d %d %d %d %d\r\n", SETTING_ID_NETMASK,
-                        settings.netmask_0, settings.netmask_1,
-                        settings.netmask_2, settings.netmask_3);
-        }
-        else if (command_line->type == 'W')
-        {
-            uint8_t netmask[4] = {0};
-            token_t* token = command_line->token;
 
-            // copy netmask from token to buffer
-            API_COPY_TOKEN_DATA_TO_BUFFER(token, netmask, 4);
+    char text_prefix[] = { prefix, '\0' };
+    api_response_begin_text(service, text_prefix, id);
+}
 
-            // update the netmask in the settings
-            settings.netmask_0 = netmask[0];
-            settings.netmask_1 = netmask[1];
-            settings.netmask_2 = netmask[2];
-            settings.netmask_3 = netmask[3];
+/**
+ * @brief   append free-form text to the tx buffer as a response of its own, e.g. the system info
+ *          the text is sent as is, it carries its own line endings, text protocol only
+ */
+void api_response_write(api_service_context_t *service, const char *text, uint16_t length)
+{
+    api_tx_buffer_t *tx = service->tx_buffer;
 
-            // save netmask in flash
-            if (flash_write_data_with_checksum(FLASH_SECTOR_SETTINGS, (uint8_t*)&settings, sizeof(settings_t)) != STATUS_OK)
-            {
-                error_code = API_ERROR_CODE_UPDATE_NETMASK_FAILED;
-            }
-            else API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SETTING_ID_GATEWAY:
-        if (command_line->type == 'R')
+    k_mutex_lock(&tx->lock, K_FOREVER);
+    tx->response_start = tx->length;
+    char *ptr = api_response_reserve(service, length);
+    if (ptr != NULL)
+    {
+        memcpy(ptr, text, length);
+        tx->length += length;
+    }
+    k_mutex_unlock(&tx->lock);
+}
+
+// append the variant to the service id, e.g. "R106.1"
+void api_response_append_variant(api_service_context_t *service, uint16_t variant)
+{
+    api_tx_buffer_t *tx = service->tx_buffer;
+
+    if (service->protocol == API_PROTOCOL_BINARY)
+    {
+        // the variant is a field of the header
+        if (tx->length - tx->response_start >= sizeof(api_frame_header_t))
         {
-            // send the gateway to the client, format: "R<Service ID> <Gateway 1> <Gateway 2> <Gateway 3> <Gateway 4>"
-            // e.g. "R103 172 16 0 1"
-            service->response_cb(service->user_data, "R%d %d %d %d %d\r\n", SETTING_ID_GATEWAY,
-                        settings.gateway_0, settings.gateway_1,
-                        settings.gateway_2, settings.gateway_3);
+            api_frame_header_t *header = (api_frame_header_t *)(tx->buffer + tx->response_start);
+            header->variant = sys_cpu_to_le16(variant);
         }
-        else if (command_line->type == 'W')
-        {
-            uint8_t gateway[4] = {0};
-            token_t* token = command_line->token;
+        return;
+    }
 
-            // copy gateway from token to buffer
-            API_COPY_TOKEN_DATA_TO_BUFFER(token, gateway, 4);
+    char *ptr = api_response_reserve(service, 1 + MAX_INT_DIGITS);
+    if (ptr == NULL)
+    {
+        return;
+    }
+    ptr[0] = '.';
+    tx->length += 1 + utils_utoa(variant, ptr + 1);
+}
 
-            // update the gateway in the settings
-            settings.gateway_0 = gateway[0];
-            settings.gateway_1 = gateway[1];
-            settings.gateway_2 = gateway[2];
-            settings.gateway_3 = gateway[3];
+// append a signed integer, text: " <Value>", binary: little-endian int32
+void api_response_append_int(api_service_context_t *service, int32_t value)
+{
+    api_tx_buffer_t *tx = service->tx_buffer;
 
-            // save gateway in flash
-            if (flash_write_data_with_checksum(FLASH_SECTOR_SETTINGS, (uint8_t*)&settings, sizeof(settings_t)) != STATUS_OK)
-            {
-                error_code = API_ERROR_CODE_UPDATE_GATEWAY_FAILED;
-            }
-            else API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SETTING_ID_MAC_ADDRESS:
-        if (command_line->type == 'R')
-        {
-            // send the MAC address to the client, format: "R<Service ID> <MAC Addr 1> <MAC Addr 2> <MAC Addr 3> <MAC Addr 4> <MAC Addr 5> <MAC Addr 6>"
-            // e.g. "R104 0 0 0 0 0 0"
-            service->response_cb(service->user_data, "R%d %d %d %d %d %d %d\r\n", SETTING_ID_MAC_ADDRESS,
-                        settings.mac_address_0, settings.mac_address_1,
-                        settings.mac_address_2, settings.mac_address_3,
-                        settings.mac_address_4, settings.mac_address_5);
-        }
-        else if (command_line->type == 'W')
-        {
-            uint8_t mac_address[6] = {0};
-            token_t* token = command_line->token;
-
-            // copy MAC address from token to buffer
-            API_COPY_TOKEN_DATA_TO_BUFFER(token, mac_address, 6);
-
-            // update the MAC address in the settings
-            settings.mac_address_0 = mac_address[0];
-            settings.mac_address_1 = mac_address[1];
-            settings.mac_address_2 = mac_address[2];
-            settings.mac_address_3 = mac_address[3];
-            settings.mac_address_4 = mac_address[4];
-            settings.mac_address_5 = mac_address[5];
-
-            // save MAC address in flash
-            if (flash_write_data_with_checksum(FLASH_SECTOR_SETTINGS, (uint8_t*)&settings, sizeof(settings_t)) != STATUS_OK)
-            {
-                error_code = API_ERROR_CODE_UPDATE_MAC_ADDRESS_FAILED;
-            }
-            else API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SETTING_ID_TCP_PORT:
-        if (command_line->type == 'R')
+    if (service->protocol == API_PROTOCOL_BINARY)
+    {
+        char *ptr = api_response_reserve(service, sizeof(int32_t));
+        if (ptr != NULL)
         {
-            // send the Ethernet port to the client, format: "R<Service ID> <Port>"
-            // e.g. "R105 80"
-            service->response_cb(service->user_data, "R%d %d\r\n", SETTING_ID_TCP_PORT, settings.tcp_port);
+            sys_put_le32((uint32_t)value, (uint8_t *)ptr);
+            tx->length += sizeof(int32_t);
         }
-        else if (command_line->type == 'W')
-        {
-            // check if token is valid
-            if (command_line->token == NULL)
-            {
-                error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                break;
-            }
+        return;
+    }
 
-            token_t* token = command_line->token;
+    char *ptr = api_response_reserve(service, 2 + MAX_INT_DIGITS);
+    if (ptr == NULL)
+    {
+        return;
+    }
+    ptr[0] = ' ';
+    tx->length += 1 + utils_itoa(value, ptr + 1);
+}
 
-            // write the Ethernet port
-            settings.tcp_port = (uint16_t)(token->i32);
+// append a bitmask, e.g. the state of all the inputs, text: " <Mask>" in unsigned decimal, binary: little-endian uint32
+void api_response_append_mask(api_service_context_t *service, uint32_t mask)
+{
+    api_tx_buffer_t *tx = service->tx_buffer;
 
-            // write the Ethernet port
-            if (flash_write_data_with_checksum(FLASH_SECTOR_SETTINGS, (uint8_t*)&settings, sizeof(settings_t)) != STATUS_OK)
-            {
-                error_code = API_ERROR_CODE_UPDATE_IP_FAILED; /////////////////////////////////////////////
-            }
-            else API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else
-        {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
-        }
-        break;
-    case SETTING_ID_BAUD_RATE:
-        // assert if variant is valid
-        if (command_line->variant >= UART_MAX)
+    if (service->protocol == API_PROTOCOL_BINARY)
+    {
+        char *ptr = api_response_reserve(service, sizeof(uint32_t));
+        if (ptr != NULL)
         {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_VARIANT;
-            break;
+            sys_put_le32(mask, (uint8_t *)ptr);
+            tx->length += sizeof(uint32_t);
         }
+        return;
+    }
 
-        if (command_line->type == 'R')
-        {
-            // send the baud rate to the client, format: "R<Service ID> <Baud Rate>"
-            // e.g. "R106.x 115200"
-            service->response_cb(service->user_data, "R%d.%d %d\r\n", SETTING_ID_BAUD_RATE, command_line->variant,
-                        settings.uart[command_line->variant].baudrate);
-        }
-        else if (command_line->type == 'W')
-        {
-            // check if token is valid
-            if (command_line->token == NULL)
-            {
-                error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
-                break;
-            }
+    char *ptr = api_response_reserve(service, 1 + MAX_INT_DIGITS);
+    if (ptr == NULL)
+    {
+        return;
+    }
+    ptr[0] = ' ';
+    tx->length += 1 + utils_utoa(mask, ptr + 1);
+}
+
+// append a literal token, e.g. " OK", literal tokens are not part of binary frames
+void api_response_append_str(api_service_context_t *service, const char *str)
+{
+    if (service->protocol == API_PROTOCOL_BINARY)
+    {
+        return;
+    }
 
-            token_t* token = command_line->token;
+    api_tx_buffer_t *tx = service->tx_buffer;
+    uint16_t length = strlen(str);
+    char *ptr = api_response_reserve(service, 1 + length);
+    if (ptr == NULL)
+    {
+        return;
+    }
+    ptr[0] = ' ';
+    memcpy(ptr + 1, str, length);
+    tx->length += 1 + length;
+}
 
-            // write the baud rate
-            settings.uart[command_line->variant].baudrate = (uint32_t)(token->i32);
+// append raw data, text: " <Data>", binary: the data as is
+void api_response_append_bytes(api_service_context_t *service, const uint8_t *data, uint16_t length)
+{
+    api_tx_buffer_t *tx = service->tx_buffer;
+    uint16_t separator = (service->protocol == API_PROTOCOL_BINARY) ? 0 : 1;
 
-            // write the baud rate
-            if (flash_write_data_with_checksum(FLASH_SECTOR_SETTINGS, (uint8_t*)&settings, sizeof(settings_t)) != STATUS_OK)
-            {
-                error_code = API_ERROR_CODE_UPDATE_IP_FAILED; /////////////////////////////////////////////
-            }
-            else API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
-        }
-        else
+    char *ptr = api_response_reserve(service, separator + length);
+    if (ptr == NULL)
+    {
+        return;
+    }
+    if (separator)
+    {
+        ptr[0] = ' ';
+    }
+    memcpy(ptr + separator, data, length);
+    tx->length += separator + length;
+}
+
+// complete the response and unlock the tx buffer, the response is sent on the next flush
+void api_response_end(api_service_context_t *service)
+{
+    api_tx_buffer_t *tx = service->tx_buffer;
+
+    if (service->protocol == API_PROTOCOL_BINARY)
+    {
+        uint16_t length = tx->length - tx->response_start;
+        if (length >= sizeof(api_frame_header_t))
         {
-            error_code = API_ERROR_CODE_INVALID_COMMAND_TYPE;
+            api_frame_header_t *header = (api_frame_header_t *)(tx->buffer + tx->response_start);
+            uint8_t *payload = (uint8_t *)header + sizeof(api_frame_header_t);
+            length -= sizeof(api_frame_header_t);
+            header->length = sys_cpu_to_le16(length);
+            header->crc = sys_cpu_to_le16(api_frame_crc(header, payload, length));
         }
-        break;
-    default:
+    }
+    else
     {
-        // debug print the command
-        LOG_DBG("Command: %c.%d \r\n", command_line->type, command_line->id);
-        service->response_cb(service->user_data, "%c%d", command_line->type, command_line->id);
-        if (command_line->variant > 0)
+        char *ptr = api_response_reserve(service, 2);
+        if (ptr == NULL)
         {
-            LOG_DBG("Variant: %d \r\n", command_line->variant);
-            service->response_cb(service->user_data, ".%d", command_line->variant);
+            // the response has been truncated, terminate it at the end of the buffer
+            tx->length = tx->size - 2;
+            ptr = tx->buffer + tx->length;
         }
-        service->response_cb(service->user_data, "\r\n");
+        ptr[0] = '\r';
+        ptr[1] = '\n';
+        tx->length += 2;
+    }
 
-        // print the parameters
-        token_t* token = command_line->token;
-        while (token != NULL)
+    k_mutex_unlock(&tx->lock);
+}
+
+// send a binary frame to the client
+void api_send_frame(api_service_context_t *service, uint8_t flags, uint16_t id, uint16_t variant,
+                    const uint8_t *payload, uint16_t length)
+{
+    api_response_begin_frame(service, flags, id);
+    api_response_append_variant(service, variant);
+    if (length > 0)
+    {
+        api_response_append_bytes(service, payload, length);
+    }
+    api_response_end(service);
+}
+
+/**
+ * @brief   respond to a read command with a list of values
+ *          text format: "R<Service ID>[.<Variant>] <Value 1> ... <Value N>\r\n"
+ *          binary format: a response frame whose payload is the values in little-endian int32
+ * @param   service       pointer to the service context
+ * @param   command_line  the command being answered
+ * @param   with_variant  print the variant after the service id in text format
+ * @param   values        values to respond
+ * @param   count         number of values
+ */
+void api_respond_values(api_service_context_t *service, command_line_t *command_line,
+                        bool with_variant, const int32_t *values, uint8_t count)
+{
+    api_response_begin(service, 'R', command_line->id);
+    if (with_variant || service->protocol == API_PROTOCOL_BINARY)
+    {
+        api_response_append_variant(service, command_line->variant);
+    }
+    for (uint8_t i = 0; i < count; i++)
+    {
+        api_response_append_int(service, values[i]);
+    }
+    api_response_end(service);
+}
+
+static void api_uart_cb(void *user_data, void *data, uint8_t length, uint8_t uart_index)
+{
+    api_service_context_t *service = (api_service_context_t *)user_data;
+    // check if the user data is valid
+    if (service == NULL)
+    {
+        return;
+    }
+    // check if the data is valid
+    if (data == NULL || length == 0)
+    {
+        return;
+    }
+    // check if the length is valid
+    if (length > UART_TX_BUFFER_SIZE)
+    {
+        length = UART_TX_BUFFER_SIZE;
+    }
+    // send the data to the client, format: "R<Service ID>.<UART Index> <Data>"
+    // in binary mode, the received data is the payload of a notification frame
+    api_response_begin(service, (service->protocol == API_PROTOCOL_BINARY) ? 'S' : 'R', SERVICE_ID_SERIAL);
+    api_response_append_variant(service, uart_index);
+    api_response_append_bytes(service, data, length);
+    api_response_end(service);
+    // the connection's own thread sends it, a slow client must not stall the UART reception
+    api_notify(service);
+}
+
+// execute the command
+void api_execute_command(api_service_context_t *service, command_line_t *command_line)
+{
+    uint16_t error_code = 0;
+
+    // look up the command in the registry
+    const api_command_t *command = api_command_get(command_line->id);
+    if (command == NULL)
+    {
+        error_code = api_command_unknown(service, command_line);
+    }
+    else
+    {
+        // check the variant, the command type and the number of parameters
+        error_code = api_command_check(command, command_line);
+
+        // check the type of the parameters, raw data is checked by the handler
+        if (command->param_type == PARAM_TYPE_INT32)
         {
-            if (token->type == TOKEN_TYPE_LENGTH)
+            for (token_t *token = command_line->token; token != NULL && error_code == 0; token = token->next)
             {
-                LOG_DBG("Length: %d \r\n", token->i32);
-            }
-            else
-            {
-                if (token->value_type == PARAM_TYPE_INT32)
-                {
-                    LOG_DBG("Param: %d \r\n", token->i32);
-                }
-                else if (token->value_type == PARAM_TYPE_FLOAT)
-                {
-                    LOG_DBG("Param: %f \r\n", (double)token->f);
-                }
-                else // PARAM_TYPE_ANY
+                if (token->value_type != PARAM_TYPE_INT32)
                 {
-                    LOG_DBG("Param: %s \r\n", (char*)token->any);
-                    // clear the buffer
-                    memset(anyTypeBuffer, '\0', sizeof(anyTypeBuffer));
+                    error_code = API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
                 }
             }
-            token = token->next;
         }
 
-        break;
-    }
+        // execute the command
+        if (error_code == 0)
+        {
+            error_code = command->handler(service, command_line);
+        }
     }
 
     // check if there is an error
@@ -1167,6 +958,22 @@ void api_execute_command(api_service_context_t *service, command_line_t *command
 void api_error(api_service_context_t *service, uint16_t error_code)
 {
     // print error code
-    service->response_cb(service->user_data, ERROR_CODE_FORMAT, error_code);
+    if (service->protocol == API_PROTOCOL_BINARY)
+    {
+        uint8_t payload[sizeof(int32_t)];
+        sys_put_le32(error_code, payload);
+        api_send_frame(service, API_FRAME_FLAG_RESPONSE | API_FRAME_FLAG_ERROR, 0, 0, payload, sizeof(payload));
+    }
+    else
+    {
+        // format: "ERR<Error Code>"
+        api_response_begin_text(service, "ERR", error_code);
+        api_response_end(service);
+    }
     LOG_ERR("Error: %d\n", error_code);
-}
\ No newline at end of file
+}
+// wake the connection's thread up to send its queued notifications, does not block
+void api_notify(api_service_context_t *service)
+{
+    k_event_post(&apiNewDataEvent, service->event);
+}
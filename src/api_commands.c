@@ -0,0 +1,1439 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(api_commands, LOG_LEVEL_INF);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/math_extras.h>
+#include "stm32f7xx_remote_io.h"
+#include "system_info.h"
+#include "api.h"
+#include "api_commands.h"
+#include "uart.h"
+#include "digital_input.h"
+#include "digital_output.h"
+#include "digital_counter.h"
+#include "digital_capture.h"
+#include "digital_sequencer.h"
+#include "digital_reflex.h"
+#include "io_scan.h"
+#include "settings.h"
+
+#ifdef CONFIG_REMOTEIO_USE_MY_WS28XX
+#include "ws28xx_pwm.h"
+#else
+#include "ws28xx_led.h"
+#endif
+
+// "W8.3" carries one parameter per LED of the strip
+BUILD_ASSERT(WS28XX_LED_COUNT <= API_MAX_TOKENS, "CONFIG_REMOTEIO_API_MAX_TOKENS must fit a whole LED frame");
+
+// used by the command registry and the variant list
+#define API_COMMAND_PARAMS(ACCESS, READ_MIN, READ_MAX, WRITE_MIN, WRITE_MAX) \
+    { \
+        .access = ACCESS, \
+        .read_params_min = READ_MIN, \
+        .read_params_max = READ_MAX, \
+        .write_params_min = WRITE_MIN, \
+        .write_params_max = WRITE_MAX, \
+    }
+#define API_COMMAND_PROTOTYPE(ID, HANDLER, ...) \
+    static uint16_t HANDLER(api_service_context_t *service, command_line_t *command_line);
+#define API_COMMAND_ENTRY(ID, HANDLER, ACCESS, READ_MIN, READ_MAX, WRITE_MIN, WRITE_MAX, PARAM_TYPE) \
+    [ID] = { \
+        .handler = HANDLER, \
+        .params = API_COMMAND_PARAMS(ACCESS, READ_MIN, READ_MAX, WRITE_MIN, WRITE_MAX), \
+        .param_type = PARAM_TYPE, \
+    },
+#define API_VARIANT_ENTRY(ID, VARIANT, ACCESS, READ_MIN, READ_MAX, WRITE_MIN, WRITE_MAX) \
+    { \
+        .id = ID, \
+        .variant = VARIANT, \
+        .params = API_COMMAND_PARAMS(ACCESS, READ_MIN, READ_MAX, WRITE_MIN, WRITE_MAX), \
+    },
+
+// function prototypes
+API_COMMAND_LIST(API_COMMAND_PROTOTYPE)
+
+// command registry indexed by the command id
+static const api_command_t api_commands[API_COMMAND_ID_MAX + 1] = {
+    API_COMMAND_LIST(API_COMMAND_ENTRY)
+};
+
+// get a command from the registry, return NULL if the id is not registered
+const api_command_t *api_command_get(uint16_t id)
+{
+    if (id > API_COMMAND_ID_MAX || api_commands[id].handler == NULL)
+    {
+        return NULL;
+    }
+
+    return &api_commands[id];
+}
+
+// variants of the commands, grouped by the command id
+static const api_command_variant_t api_variants[] = {
+    API_VARIANT_LIST(API_VARIANT_ENTRY)
+};
+
+// check the access and the number of parameters of a command line, return 0 if valid or an API error code
+static uint16_t api_command_check_params(const api_command_params_t *params, const command_line_t *command_line)
+{
+    // check if the command type is allowed
+    if ((command_line->type == 'R' && !(params->access & API_ACCESS_R)) ||
+        (command_line->type == 'W' && !(params->access & API_ACCESS_W)))
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_TYPE;
+    }
+
+    // check the number of parameters
+    uint8_t params_min = (command_line->type == 'R') ? params->read_params_min : params->write_params_min;
+    uint8_t params_max = (command_line->type == 'R') ? params->read_params_max : params->write_params_max;
+    if (command_line->token_count < params_min || command_line->token_count > params_max)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+    }
+    return 0;
+}
+
+/**
+ * @brief   check a command line against the registry entry of its command and the entry of its variant
+ * @param   command  registry entry of the command, see api_command_get()
+ * @return  0 if the command line is valid, API_ERROR_CODE_INVALID_COMMAND_VARIANT if the command has
+ *          listed variants but not this one, another API error code if the access or the parameters are invalid
+ */
+uint16_t api_command_check(const api_command_t *command, const command_line_t *command_line)
+{
+    bool listed = false;
+    for (size_t i = 0; i < ARRAY_SIZE(api_variants); i++)
+    {
+        if (api_variants[i].id != command_line->id)
+        {
+            // the variants of a command are grouped, there are no more after the group
+            if (listed)
+            {
+                break;
+            }
+            continue;
+        }
+        listed = true;
+        if (api_variants[i].variant == command_line->variant)
+        {
+            uint16_t error_code = api_command_check_params(&api_variants[i].params, command_line);
+            if (error_code != 0)
+            {
+                return error_code;
+            }
+            return api_command_check_params(&command->params, command_line);
+        }
+    }
+
+    return listed ? API_ERROR_CODE_INVALID_COMMAND_VARIANT : api_command_check_params(&command->params, command_line);
+}
+
+static void api_callback(void *user_data, const char *text, uint16_t length)
+{
+    // check if the user data is valid
+    if (user_data == NULL)
+    {
+        return;
+    }
+
+    // get the service
+    api_service_context_t *service = (api_service_context_t *)user_data;
+
+    api_response_write(service, text, length);
+}
+
+// called by the digital input task, the capture or the sequencer timer when notifications are queued for the connection
+static void api_queue_notify(void *user_data)
+{
+    api_notify((api_service_context_t *)user_data);
+}
+
+/**
+ * @brief   send the queued input events of a connection, called from the connection's own thread
+ *          format: "S<Service ID> <Input Index> <State> <Timestamp> <Sequence>"
+ *          coalesced format: "S<Service ID>.1 <Changed Inputs> <State> <Timestamp> <Sequence>"
+ *          lost events: "S<Service ID>.2 <Number of Dropped Events>"
+ */
+static void api_send_input_events(api_service_context_t *service)
+{
+    digital_input_event_t event;
+
+    while (digital_input_get_event(service, &event))
+    {
+        api_response_begin(service, 'S', SERVICE_ID_SUBSCRIBE_INPUT);
+        if (event.coalesced)
+        {
+            api_response_append_variant(service, API_SUBSCRIBE_VARIANT_COALESCED);
+            api_response_append_mask(service, event.changed);
+            api_response_append_mask(service, event.state);
+        }
+        else
+        {
+            uint8_t index = u32_count_trailing_zeros(event.changed);
+            api_response_append_int(service, index + 1);
+            api_response_append_int(service, (event.state >> index) & 0x01);
+        }
+        api_response_append_mask(service, event.timestamp);
+        api_response_append_mask(service, event.sequence);
+        api_response_end(service);
+    }
+
+    // report lost events after the events queued before the ring was full
+    uint32_t dropped = digital_input_take_dropped(service);
+    if (dropped != 0)
+    {
+        api_response_begin(service, 'S', SERVICE_ID_SUBSCRIBE_INPUT);
+        api_response_append_variant(service, API_SUBSCRIBE_VARIANT_DROPPED);
+        api_response_append_mask(service, dropped);
+        api_response_end(service);
+    }
+}
+
+/**
+ * @brief   send the captured records of a connection, called from the connection's own thread
+ *          format: "S<Service ID> <Length> <Records>", records of 4 bytes: state and sample count,
+ *          each a little-endian uint16
+ *          end of the capture: "S<Service ID>.1 <Number of Samples> <Number of Dropped Records>"
+ */
+static void api_send_capture(api_service_context_t *service)
+{
+    if (!digital_capture_is_owner(service))
+    {
+        return;
+    }
+
+    // the state is read first, the records of a finished capture are all in the buffer by then
+    digital_capture_status_t status;
+    digital_capture_get_status(&status);
+
+    uint8_t block[API_CAPTURE_BLOCK_SIZE];
+    uint32_t length;
+    while ((length = digital_capture_read(service, block, sizeof(block))) != 0)
+    {
+        api_response_begin(service, 'S', SERVICE_ID_CAPTURE);
+        api_response_append_mask(service, length);
+        api_response_append_bytes(service, block, (uint16_t)length);
+        api_response_end(service);
+    }
+
+    if (status.state == DIGITAL_CAPTURE_STATE_DONE)
+    {
+        api_response_begin(service, 'S', SERVICE_ID_CAPTURE);
+        api_response_append_variant(service, API_CAPTURE_VARIANT_STOP);
+        api_response_append_mask(service, status.samples);
+        api_response_append_mask(service, status.dropped);
+        api_response_end(service);
+        digital_capture_release(service);
+    }
+}
+
+/**
+ * @brief   send the events of the output sequencer of a connection, called from the connection's own thread
+ *          end of a table: "S<Service ID>.2 <Number of Tables Played>"
+ *          underrun: "S<Service ID>.3 <Number of Tables Played>", the playback has stopped
+ */
+static void api_send_sequencer_events(api_service_context_t *service)
+{
+    uint32_t events = digital_sequencer_take_events(service);
+    if (events == 0)
+    {
+        return;
+    }
+
+    digital_sequencer_status_t status;
+    digital_sequencer_get_status(&status);
+    if (events & DIGITAL_SEQUENCER_EVENT_DONE)
+    {
+        api_response_begin(service, 'S', SERVICE_ID_SEQUENCER);
+        api_response_append_variant(service, API_SEQUENCER_VARIANT_START);
+        api_response_append_mask(service, status.passes);
+        api_response_end(service);
+    }
+    if (events & DIGITAL_SEQUENCER_EVENT_UNDERRUN)
+    {
+        api_response_begin(service, 'S', SERVICE_ID_SEQUENCER);
+        api_response_append_variant(service, API_SEQUENCER_VARIANT_STOP);
+        api_response_append_mask(service, status.passes);
+        api_response_end(service);
+    }
+}
+
+// send the notifications queued for a connection, called from the connection's own thread when it is idle
+void api_send_notifications(api_service_context_t *service)
+{
+    api_send_input_events(service);
+    api_send_capture(service);
+    api_send_sequencer_events(service);
+}
+
+// reply the default response after the settings are saved in flash
+static uint16_t api_save_settings(api_service_context_t *service, command_line_t *command_line, uint16_t error_code)
+{
+    if (settings_save() != STATUS_OK)
+    {
+        return error_code;
+    }
+
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+/**
+ * @brief   read or write a setting made of consecutive bytes, e.g. the IP address
+ *          read format: "R<Setting ID> <Byte 1> ... <Byte N>"
+ *          write format: "W<Setting ID> <Byte 1> ... <Byte N>"
+ * @param   field       pointer to the first byte of the setting in the settings
+ * @param   count       number of bytes
+ * @param   error_code  error code in case the settings cannot be saved
+ */
+static uint16_t api_setting_bytes(api_service_context_t *service, command_line_t *command_line,
+                                  uint8_t *field, uint8_t count, uint16_t error_code)
+{
+    if (command_line->type == 'R')
+    {
+        api_response_begin(service, 'R', command_line->id);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            api_response_append_int(service, field[i]);
+        }
+        api_response_end(service);
+        return 0;
+    }
+
+    // the number of parameters is checked by the dispatcher
+    token_t *token = command_line->token;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        field[i] = (uint8_t)token->i32;
+        token = token->next;
+    }
+
+    return api_save_settings(service, command_line, error_code);
+}
+
+static uint16_t api_cmd_status(api_service_context_t *service, command_line_t *command_line)
+{
+    // send default response
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+static uint16_t api_cmd_system_info(api_service_context_t *service, command_line_t *command_line)
+{
+    // system info is free-form text
+    if (service->protocol == API_PROTOCOL_BINARY)
+    {
+        return API_ERROR_CODE_NOT_SUPPORTED_IN_BINARY_MODE;
+    }
+
+    // get system info
+    system_info_print(service, &api_callback);
+    return 0;
+}
+
+static uint16_t api_cmd_serial(api_service_context_t *service, command_line_t *command_line)
+{
+    // the length token is followed by the message token
+    token_t *length_token = command_line->token;
+    token_t *token = length_token->next;
+    if (length_token->type != TOKEN_TYPE_LENGTH || token->value_type != PARAM_TYPE_ANY)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+    }
+
+    // ensure the index of uart is valid
+    if (command_line->variant >= UART_MAX)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+    }
+
+    // send the message to the serial port
+    uart_printf((uart_index_t)(command_line->variant), (uint8_t*)token->any, (uint16_t)length_token->i32);
+    // reply with default response
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+// read the inputs latched since the last read and clear the latches
+// format: "R3.1 <Active Inputs> <Rising Edges> <Falling Edges>", each a bit mask of the inputs,
+// an input is active if it is active now or had an edge since the last read
+static uint16_t api_cmd_input_latched(api_service_context_t *service, command_line_t *command_line)
+{
+    uint32_t rising = 0;
+    uint32_t falling = 0;
+    uint32_t active = digital_input_read_latched(&rising, &falling);
+    api_response_begin(service, 'R', command_line->id);
+    api_response_append_variant(service, command_line->variant);
+    api_response_append_mask(service, active);
+    api_response_append_mask(service, rising);
+    api_response_append_mask(service, falling);
+    api_response_end(service);
+    return 0;
+}
+
+static uint16_t api_cmd_input(api_service_context_t *service, command_line_t *command_line)
+{
+    if (command_line->variant == API_INPUT_VARIANT_LATCHED)
+    {
+        return api_cmd_input_latched(service, command_line);
+    }
+    int32_t index = command_line->token->i32;
+
+    // if the parameter equals to -1, read all the digital inputs
+    if (index == -1)
+    {
+        // send the state of all the digital inputs to the client, format: "R<Service ID> <State>"
+        api_response_begin(service, 'R', command_line->id);
+        api_response_append_mask(service, digital_input_read_all());
+        api_response_end(service);
+        return 0;
+    }
+
+    // check if parameter is valid
+    if (index < 1 || index > DIGITAL_INPUT_MAX)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+    }
+
+    // read the state of specified digital input
+    int32_t values[] = { index, digital_input_read((uint8_t)(index - 1)) };
+    // send the state to the client, format: "R<Service ID> <Input Index> <State>"
+    api_respond_values(service, command_line, false, values, ARRAY_SIZE(values));
+    return 0;
+}
+
+// select the notification format of the subscribed inputs
+// read format: "R5.1 <Mode> <Window>"
+// write format: "W5.1 <Mode> <Window>", mode 0 notifies each input, mode 1 sends all changes
+// within the window in ms as one "S5.1" notification, see api_send_input_events()
+static uint16_t api_cmd_subscribe_input_mode(api_service_context_t *service, command_line_t *command_line)
+{
+    if (command_line->type == 'R')
+    {
+        uint16_t window = 0;
+        bool coalesced = digital_input_get_coalescing(service, &window);
+        int32_t values[] = { coalesced, window };
+        api_respond_values(service, command_line, true, values, ARRAY_SIZE(values));
+        return 0;
+    }
+
+    int32_t mode = command_line->token->i32;
+    int32_t window = command_line->token->next->i32;
+    if ((mode != 0 && mode != 1) || window < 0 || window > UINT16_MAX)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+    }
+
+    if (digital_input_set_coalescing(service, (mode == 1), (uint16_t)window) != STATUS_OK)
+    {
+        return API_ERROR_CODE_SUBSCRIBE_INPUT_FAILED;
+    }
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+static uint16_t api_cmd_subscribe_input(api_service_context_t *service, command_line_t *command_line)
+{
+    if (command_line->variant == API_SUBSCRIBE_VARIANT_COALESCED)
+    {
+        return api_cmd_subscribe_input_mode(service, command_line);
+    }
+
+    if (command_line->type == 'R')
+    {
+        // send the subscribed inputs to the client, format: "R<Service ID> <Input Index 1> ... <Input Index N>"
+        uint32_t mask = digital_input_get_subscribed(service);
+        api_response_begin(service, 'R', command_line->id);
+        for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++)
+        {
+            if (mask & BIT(i))
+            {
+                api_response_append_int(service, i + 1);
+            }
+        }
+        api_response_end(service);
+        return 0;
+    }
+
+    // check if all the parameters are valid before subscribing
+    for (token_t *token = command_line->token; token != NULL; token = token->next)
+    {
+        if (token->i32 < 1 || token->i32 > DIGITAL_INPUT_MAX)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+    }
+
+    for (token_t *token = command_line->token; token != NULL; token = token->next)
+    {
+        // subscribe to the digital input
+        if (digital_input_subscribe(service, (token->i32 - 1), &api_queue_notify) != STATUS_OK)
+        {
+            return API_ERROR_CODE_SUBSCRIBE_INPUT_FAILED;
+        }
+    }
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+static uint16_t api_cmd_unsubscribe_input(api_service_context_t *service, command_line_t *command_line)
+{
+    // check if all the parameters are valid before unsubscribing
+    for (token_t *token = command_line->token; token != NULL; token = token->next)
+    {
+        if (token->i32 < 1 || token->i32 > DIGITAL_INPUT_MAX)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+    }
+
+    for (token_t *token = command_line->token; token != NULL; token = token->next)
+    {
+        // unsubscribe to the digital input
+        digital_input_unsubscribe(service, token->i32 - 1);
+    }
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+// compare the outputs as written against the ports once per scan
+// read format: "R4.2 <Enabled> <Number of Mismatches> <Mismatched Outputs>"
+// write format: "W4.2 <Enabled>", enabling the verify mode clears the mismatches
+static uint16_t api_cmd_output_verify(api_service_context_t *service, command_line_t *command_line)
+{
+    if (command_line->type == 'R')
+    {
+        uint32_t mismatches = 0;
+        uint32_t outputs = 0;
+        bool enabled = digital_output_get_verify(&mismatches, &outputs);
+        api_response_begin(service, 'R', command_line->id);
+        api_response_append_variant(service, command_line->variant);
+        api_response_append_int(service, enabled);
+        api_response_append_mask(service, mismatches);
+        api_response_append_mask(service, outputs);
+        api_response_end(service);
+        return 0;
+    }
+
+    int32_t enable = command_line->token->i32;
+    if (enable < 0 || enable > 1)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+    }
+    digital_output_set_verify(enable == 1);
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+/**
+ * @brief   timed pulses on a digital output, the edges are generated by the device
+ *          "W4.3 <Output Index> <On Time>"                         one pulse of the on time in ms
+ *          "W4.3 <Output Index> <On Time> <Off Time> <Count>"      count pulses with the off time in between,
+ *                                                                  count 0 repeats until stopped
+ *          "W4.3 <Output Index> 0"                                 stop the pulses, the output becomes inactive
+ *          "R4.3"                                                  "R4.3 <Pulsing Outputs>" as a bit mask
+ *          any other write to the output stops its pulses as well
+ */
+static uint16_t api_cmd_output_pulse(api_service_context_t *service, command_line_t *command_line)
+{
+    token_t *token = command_line->token;
+
+    if (command_line->type == 'R')
+    {
+        api_response_begin(service, 'R', command_line->id);
+        api_response_append_variant(service, command_line->variant);
+        api_response_append_mask(service, digital_output_get_pulsing());
+        api_response_end(service);
+        return 0;
+    }
+
+    // the off time comes with the count
+    if (command_line->token_count == 3)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+    }
+    int32_t output_index = token->i32;
+    int32_t on_time = token->next->i32;
+    int32_t off_time = 0;
+    int32_t count = 1;
+    if (command_line->token_count == 4)
+    {
+        off_time = token->next->next->i32;
+        count = token->next->next->next->i32;
+    }
+    if (output_index < 1 || output_index > DIGITAL_OUTPUT_MAX || on_time < 0 || off_time < 0 || count < 0)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+    }
+
+    int ret;
+    if (on_time == 0)
+    {
+        ret = digital_output_write((uint8_t)(output_index - 1), false);
+    }
+    else
+    {
+        ret = digital_output_pulse((uint8_t)(output_index - 1), on_time, off_time, count);
+        if (ret == -EINVAL)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+    }
+    if (ret < 0)
+    {
+        return API_ERROR_CODE_WRITE_DIGITAL_OUTPUT_FAILED;
+    }
+
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+static uint16_t api_cmd_output(api_service_context_t *service, command_line_t *command_line)
+{
+    token_t* token = command_line->token;
+
+    if (command_line->variant == API_OUTPUT_VARIANT_VERIFY)
+    {
+        return api_cmd_output_verify(service, command_line);
+    }
+    if (command_line->variant == API_OUTPUT_VARIANT_PULSE)
+    {
+        return api_cmd_output_pulse(service, command_line);
+    }
+
+    // get output index
+    int32_t output_index = token->i32;
+
+    if (command_line->type == 'R')
+    {
+        if (output_index == -1)
+        {
+            // send the state of all the digital outputs to the client, format: "R<Service ID> <State>"
+            api_response_begin(service, 'R', command_line->id);
+            api_response_append_mask(service, digital_output_read_all());
+            api_response_end(service);
+            return 0;
+        }
+
+        // check if parameter is valid
+        if (output_index < 1 || output_index > DIGITAL_OUTPUT_MAX)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        // read the state of specified digital output
+        int32_t values[] = { output_index, digital_output_read((uint8_t)output_index - 1) };
+        // send the state to the client, format: "R<Service ID> <Output Index> <State>"
+        api_respond_values(service, command_line, false, values, ARRAY_SIZE(values));
+        return 0;
+    }
+
+    // handle different variants of the command
+    switch (command_line->variant)
+    {
+    case API_OUTPUT_VARIANT_MULTIPLE: // write to multiple outputs, format: "W4.1 <Data> <Start Index> <Length>"
+    {
+        // get the write value
+        uint32_t data = token->i32;
+
+        // get the start index
+        token = token->next;
+        int32_t start_index = token->i32;
+
+        // check if parameter is valid
+        if (start_index < 1 || start_index > DIGITAL_OUTPUT_MAX)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+
+        // get the length, it is checked before it is narrowed
+        token = token->next;
+        int32_t length = token->i32;
+        if (length < 1 || length > DIGITAL_OUTPUT_MAX - (start_index - 1))
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+
+        // write to multiple digital outputs, in step with the scan cycles if the scan engine runs
+        if (io_scan_write(BIT_MASK((uint8_t)length) << (start_index - 1), data << (start_index - 1)) < 0)
+        {
+            return API_ERROR_CODE_WRITE_DIGITAL_OUTPUT_FAILED;
+        }
+        break;
+    }
+    default: // write to single output, format: "W4 <Output Index> <State>"
+    {
+        // check if parameter is valid
+        if (output_index < 1 || output_index > DIGITAL_OUTPUT_MAX)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+
+        // get the write value
+        bool state = (token->next->i32 > 0) ? true : false;
+
+        // write to the digital output, in step with the scan cycles if the scan engine runs
+        if (io_scan_write(BIT(output_index - 1), state ? BIT(output_index - 1) : 0) < 0)
+        {
+            return API_ERROR_CODE_WRITE_DIGITAL_OUTPUT_FAILED;
+        }
+        break;
+    }
+    }
+
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+static uint16_t api_cmd_ws28xx_led(api_service_context_t *service, command_line_t *command_line)
+{
+    token_t* token = command_line->token;
+
+    if (command_line->type == 'R')
+    {
+        // get the LED index
+        uint16_t led_index = token->i32;
+        // read the color of the LED
+        uint8_t r = 0, g = 0, b = 0;
+        // get the color of the LED
+        if (ws28xx_led_get_color(&r, &g, &b, led_index) != 0)
+        {
+            return API_ERROR_CODE_GET_LED_COLOR_FAILED;
+        }
+        // send the color to the client, format: "R<Service ID> <LED Index> <R> <G> <B>"
+        int32_t values[] = { led_index, r, g, b };
+        api_respond_values(service, command_line, false, values, ARRAY_SIZE(values));
+        return 0;
+    }
+
+    // staged variants only change the pixels, the strip is refreshed by "W8.4"
+    uint16_t variant = command_line->variant;
+    bool refresh = true;
+    if (variant >= API_LED_VARIANT_STAGED)
+    {
+        variant -= API_LED_VARIANT_STAGED;
+        refresh = false;
+    }
+
+    int ret = 0;
+    switch (variant)
+    {
+    case API_LED_VARIANT_PIXEL: // set a single LED, format: "W8 <LED Index> <R> <G> <B>"
+    {
+        uint16_t led_index = token->i32;
+        token = token->next;
+        uint8_t r = (uint8_t)token->i32;
+        token = token->next;
+        uint8_t g = (uint8_t)token->i32;
+        token = token->next;
+        uint8_t b = (uint8_t)token->i32;
+
+        ret = refresh ? ws28xx_led_set_color(r, g, b, led_index) : ws28xx_led_set_range(led_index, 1, r, g, b, false);
+        break;
+    }
+    case API_LED_VARIANT_RANGE: // set a range of LEDs to one color, format: "W8.1 <Start Index> <Count> <R> <G> <B>"
+    {
+        uint16_t start_index = token->i32;
+        token = token->next;
+        uint16_t count = token->i32;
+        token = token->next;
+        uint8_t r = (uint8_t)token->i32;
+        token = token->next;
+        uint8_t g = (uint8_t)token->i32;
+        token = token->next;
+        uint8_t b = (uint8_t)token->i32;
+
+        ret = ws28xx_led_set_range(start_index, count, r, g, b, refresh);
+        break;
+    }
+    case API_LED_VARIANT_LIST: // set consecutive LEDs, format: "W8.2 <Start Index> <RGB 1> ... <RGB N>"
+    case API_LED_VARIANT_FRAME: // set the whole strip, format: "W8.3 <RGB 1> ... <RGB N>"
+    {
+        uint16_t start_index = 0;
+        if (variant == API_LED_VARIANT_LIST)
+        {
+            if (command_line->token_count - 1 > WS28XX_LED_COUNT)
+            {
+                return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+            }
+            start_index = token->i32;
+            token = token->next;
+        }
+        else if (command_line->token_count != WS28XX_LED_COUNT)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+
+        // colors are packed as 0xRRGGBB
+        uint32_t colors[WS28XX_LED_COUNT];
+        uint16_t count = 0;
+        for (; token != NULL; token = token->next)
+        {
+            colors[count++] = (uint32_t)token->i32;
+        }
+
+        ret = ws28xx_led_set_list(start_index, colors, count, refresh);
+        break;
+    }
+    case API_LED_VARIANT_COMMIT: // refresh the strip with the staged pixels, format: "W8.4"
+    {
+        if (ws28xx_led_update() != 0)
+        {
+            return API_ERROR_CODE_UPDATE_LED_FAILED;
+        }
+        break;
+    }
+    default:
+        return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+    }
+
+    if (ret != 0)
+    {
+        return API_ERROR_CODE_SET_LED_COLOR_FAILED;
+    }
+
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+static uint16_t api_cmd_protocol(api_service_context_t *service, command_line_t *command_line)
+{
+    if (command_line->type == 'R')
+    {
+        // send the protocol to the client, format: "R<Service ID> <Protocol>"
+        int32_t protocol = service->protocol;
+        api_respond_values(service, command_line, false, &protocol, 1);
+        return 0;
+    }
+
+    // check if parameter is valid
+    int32_t protocol = command_line->token->i32;
+    if (protocol != API_PROTOCOL_TEXT && protocol != API_PROTOCOL_BINARY)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+    }
+
+    // acknowledge with the current protocol, then switch
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    service->protocol = (uint8_t)protocol;
+    return 0;
+}
+
+// exchange the process image in one round trip:
+// "W12 <Sequence> <Output Mask> <Output Value>" writes the outputs selected by the mask,
+// "R12 <Sequence>" only reads; both respond with "R12 <Sequence> <Input State> <Output State>"
+static uint16_t api_cmd_exchange(api_service_context_t *service, command_line_t *command_line)
+{
+    token_t* token = command_line->token;
+    int32_t sequence = token->i32;
+
+    if (command_line->type == 'W')
+    {
+        uint32_t mask = (uint32_t)token->next->i32;
+        uint32_t value = (uint32_t)token->next->next->i32;
+
+        // check if the mask only selects existing outputs
+        if (mask & ~BIT_MASK(DIGITAL_OUTPUT_MAX))
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        if (io_scan_write(mask, value) < 0)
+        {
+            return API_ERROR_CODE_WRITE_DIGITAL_OUTPUT_FAILED;
+        }
+    }
+
+    // read the inputs after the outputs are applied, or queued for the next cycle if the scan engine runs
+    api_response_begin(service, 'R', command_line->id);
+    api_response_append_int(service, sequence);
+    api_response_append_mask(service, digital_input_read_all());
+    api_response_append_mask(service, digital_output_read_all());
+    api_response_end(service);
+    return 0;
+}
+
+/**
+ * @brief   edge counters and frequency measurement of the digital inputs
+ *          "R13"                               counters of all inputs, "R13 <Count 1> ... <Count N>"
+ *          "R13.1"                             same as "R13", the counters are cleared while read
+ *          "R13.2"                             "R13.2 <Gate Time> <Frequency 1> ... <Frequency N>" in mHz
+ *          "R13.3 <Input Index>"               "R13.3 <Input Index> <Count High> <Count Low>", 64-bit counter
+ *          "W13 <Input Index> <Mode>"          counted edges, 0 off, 1 rising, 2 falling, 3 both,
+ *                                              the input index -1 selects all inputs
+ *          "W13.2 <Gate Time>"                 gate time of the frequency measurement in ms
+ *          counts are the low 32 bits of the counters
+ */
+static uint16_t api_cmd_counter(api_service_context_t *service, command_line_t *command_line)
+{
+    token_t *token = command_line->token;
+
+    if (command_line->type == 'R')
+    {
+        switch (command_line->variant)
+        {
+        case API_COUNTER_VARIANT_COUNT:
+        case API_COUNTER_VARIANT_CLEAR:
+        {
+            bool clear = (command_line->variant == API_COUNTER_VARIANT_CLEAR);
+            api_response_begin(service, 'R', command_line->id);
+            if (clear)
+            {
+                api_response_append_variant(service, command_line->variant);
+            }
+            for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++)
+            {
+                api_response_append_mask(service, (uint32_t)digital_counter_read(i, clear));
+            }
+            api_response_end(service);
+            return 0;
+        }
+        case API_COUNTER_VARIANT_FREQUENCY:
+        {
+            api_response_begin(service, 'R', command_line->id);
+            api_response_append_variant(service, command_line->variant);
+            api_response_append_int(service, digital_counter_get_gate_time());
+            for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++)
+            {
+                api_response_append_mask(service, digital_counter_get_frequency(i));
+            }
+            api_response_end(service);
+            return 0;
+        }
+        case API_COUNTER_VARIANT_WIDE:
+        {
+            if (token->i32 < 1 || token->i32 > DIGITAL_INPUT_MAX)
+            {
+                return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+            }
+            uint64_t count = digital_counter_read(token->i32 - 1, false);
+            api_response_begin(service, 'R', command_line->id);
+            api_response_append_variant(service, command_line->variant);
+            api_response_append_int(service, token->i32);
+            api_response_append_mask(service, (uint32_t)(count >> 32));
+            api_response_append_mask(service, (uint32_t)count);
+            api_response_end(service);
+            return 0;
+        }
+        default:
+            return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+        }
+    }
+
+    switch (command_line->variant)
+    {
+    case API_COUNTER_VARIANT_COUNT:
+    {
+        int32_t input_index = token->i32;
+        int32_t mode = token->next->i32;
+        if ((input_index != -1 && (input_index < 1 || input_index > DIGITAL_INPUT_MAX)) ||
+            mode < DIGITAL_COUNTER_MODE_OFF || mode > DIGITAL_COUNTER_MODE_BOTH)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++)
+        {
+            if (input_index == -1 || input_index == i + 1)
+            {
+                digital_counter_set_mode(i, (uint8_t)mode);
+            }
+        }
+        break;
+    }
+    case API_COUNTER_VARIANT_FREQUENCY:
+    {
+        if (token->i32 < 0 || token->i32 > UINT16_MAX || digital_counter_set_gate_time((uint16_t)token->i32) != STATUS_OK)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        break;
+    }
+    default:
+        return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+    }
+
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+/**
+ * @brief   logic-analyzer capture of the digital inputs, one connection at a time
+ *          "W14 <Period> <Samples> [<Trigger Mask> <Trigger Value> [<Trigger Edges>]]"
+ *                      sample all inputs every period in us, a whole number of system ticks,
+ *                      record the given number of samples once the masked inputs equal the value and, if edges are given,
+ *                      one of these inputs changed; the records are streamed as "S14" notifications
+ *          "W14.1"     stop the capture, the remaining records are sent before "S14.1"
+ *          "R14"       "R14 <State> <Number of Samples> <Number of Dropped Records>",
+ *                      state 0 idle, 1 waiting for the trigger, 2 recording, 3 done
+ */
+static uint16_t api_cmd_capture(api_service_context_t *service, command_line_t *command_line)
+{
+    token_t *token = command_line->token;
+
+    if (command_line->type == 'R')
+    {
+        digital_capture_status_t status;
+        digital_capture_get_status(&status);
+        api_response_begin(service, 'R', command_line->id);
+        api_response_append_int(service, status.state);
+        api_response_append_mask(service, status.samples);
+        api_response_append_mask(service, status.dropped);
+        api_response_end(service);
+        return 0;
+    }
+
+    switch (command_line->variant)
+    {
+    case API_CAPTURE_VARIANT_START:
+    {
+        // the trigger value comes with the trigger mask
+        if (command_line->token_count == 3)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        digital_capture_config_t config = {0};
+        config.period = (uint32_t)token->i32;
+        token = token->next;
+        config.samples = (uint32_t)token->i32;
+        token = token->next;
+        if (token != NULL)
+        {
+            config.trigger_mask = (uint32_t)token->i32;
+            config.trigger_value = (uint32_t)token->next->i32;
+            token = token->next->next;
+        }
+        if (token != NULL)
+        {
+            config.trigger_edges = (uint32_t)token->i32;
+        }
+        if (digital_capture_start(service, &api_queue_notify, &config) != STATUS_OK)
+        {
+            return API_ERROR_CODE_START_CAPTURE_FAILED;
+        }
+        break;
+    }
+    case API_CAPTURE_VARIANT_STOP:
+    {
+        digital_capture_stop(service);
+        break;
+    }
+    default:
+        return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+    }
+
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+/**
+ * @brief   output sequencer playing tables of timed steps, owned by one connection at a time
+ *          "W15 <Delta Time> <Set Mask> <Clear Mask> ..."  append steps to the loaded table,
+ *                                                          the delta time in ms is counted from the previous step
+ *          "W15.1"                                         empty the loaded table
+ *          "W15.2 <Mode>"                                  play the loaded table, 0 once, 1 looped, 2 streamed:
+ *                                                          followed by the next table, or an underrun "S15.3";
+ *                                                          while a table plays, the loaded table is queued
+ *                                                          and takes over at its end, notified by "S15.2"
+ *          "W15.3"                                         stop the playback, the outputs keep their state
+ *          "R15"                                           "R15 <Playing> <Mode> <Step> <Tables Played> <Loaded Steps> <Queued>"
+ */
+static uint16_t api_cmd_sequencer(api_service_context_t *service, command_line_t *command_line)
+{
+    token_t *token = command_line->token;
+
+    if (command_line->type == 'R')
+    {
+        digital_sequencer_status_t status;
+        digital_sequencer_get_status(&status);
+        int32_t values[] = { status.playing, status.mode, status.step, status.passes, status.loaded, status.queued };
+        api_respond_values(service, command_line, false, values, ARRAY_SIZE(values));
+        return 0;
+    }
+
+    switch (command_line->variant)
+    {
+    case API_SEQUENCER_VARIANT_LOAD:
+    {
+        digital_sequencer_step_t steps[API_MAX_TOKENS / 3];
+        uint16_t count = command_line->token_count / 3;
+        if (command_line->token_count % 3 != 0)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        for (uint16_t i = 0; i < count; i++)
+        {
+            if (token->i32 < 0)
+            {
+                return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+            }
+            steps[i].delta_time = (uint32_t)token->i32;
+            steps[i].set_mask = (uint32_t)token->next->i32;
+            steps[i].clear_mask = (uint32_t)token->next->next->i32;
+            token = token->next->next->next;
+        }
+        if (digital_sequencer_load(service, steps, count) != STATUS_OK)
+        {
+            return API_ERROR_CODE_LOAD_SEQUENCE_FAILED;
+        }
+        break;
+    }
+    case API_SEQUENCER_VARIANT_CLEAR:
+    {
+        if (digital_sequencer_clear(service) != STATUS_OK)
+        {
+            return API_ERROR_CODE_LOAD_SEQUENCE_FAILED;
+        }
+        break;
+    }
+    case API_SEQUENCER_VARIANT_START:
+    {
+        if (token->i32 < DIGITAL_SEQUENCER_MODE_ONCE || token->i32 > DIGITAL_SEQUENCER_MODE_STREAM)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        if (digital_sequencer_start(service, &api_queue_notify, (uint8_t)token->i32) != STATUS_OK)
+        {
+            return API_ERROR_CODE_START_SEQUENCE_FAILED;
+        }
+        break;
+    }
+    case API_SEQUENCER_VARIANT_STOP:
+    {
+        digital_sequencer_stop(service);
+        break;
+    }
+    default:
+        return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+    }
+
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+/**
+ * @brief   reflex rules switching the outputs on conditions of the debounced inputs, evaluated on the device
+ *          after each 1 ms input scan, or after each cycle of the scan engine while it runs
+ *          "W16 <Rule Index> <Input Mask> <Input Value> <Output Index> <Action> [<Delay>]"
+ *                              set a rule, the index after the last rule appends it; the output takes the action
+ *                              when the masked inputs equal the value: 0 set, 1 clear, 2 follow, 3 follow inverted,
+ *                              after the condition has been met or not met for the delay in ms
+ *          "R16"               "R16 <Enabled> <Number of Rules>"
+ *          "R16 <Rule Index>"  "R16 <Rule Index> <Input Mask> <Input Value> <Output Index> <Action> <Delay>"
+ *          "W16.1 <Enabled>"   enable or disable all rules
+ *          "W16.2 [<Rule Index>]" delete a rule, or all rules
+ *          "W16.3"             save the rules and the enable flag in flash, they are loaded at startup
+ */
+static uint16_t api_cmd_reflex(api_service_context_t *service, command_line_t *command_line)
+{
+    token_t *token = command_line->token;
+
+    if (command_line->type == 'R')
+    {
+        if (command_line->token_count == 0)
+        {
+            int32_t values[] = { digital_reflex_is_enabled(), digital_reflex_count() };
+            api_respond_values(service, command_line, false, values, ARRAY_SIZE(values));
+            return 0;
+        }
+        digital_reflex_rule_t rule;
+        if (token->i32 < 1 || token->i32 > DIGITAL_REFLEX_RULES_MAX ||
+            digital_reflex_get_rule((uint8_t)(token->i32 - 1), &rule) != STATUS_OK)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        int32_t values[] = { token->i32, rule.input_mask, rule.input_value, rule.output + 1, rule.action, rule.delay };
+        api_respond_values(service, command_line, false, values, ARRAY_SIZE(values));
+        return 0;
+    }
+
+    switch (command_line->variant)
+    {
+    case API_REFLEX_VARIANT_RULE:
+    {
+        int32_t params[6] = { 0 };
+        for (uint8_t i = 0; i < command_line->token_count; i++, token = token->next)
+        {
+            params[i] = token->i32;
+        }
+        if (params[0] < 1 || params[0] > DIGITAL_REFLEX_RULES_MAX || params[1] < 0 || params[1] > UINT16_MAX ||
+            params[2] < 0 || params[2] > UINT16_MAX || params[3] < 1 || params[3] > DIGITAL_OUTPUT_MAX ||
+            params[4] < 0 || params[4] > UINT8_MAX || params[5] < 0 || params[5] > UINT16_MAX)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        digital_reflex_rule_t rule = {
+            .input_mask = (uint16_t)params[1],
+            .input_value = (uint16_t)params[2],
+            .output = (uint8_t)(params[3] - 1),
+            .action = (uint8_t)params[4],
+            .delay = (uint16_t)params[5],
+        };
+        if (digital_reflex_set_rule((uint8_t)(params[0] - 1), &rule) != STATUS_OK)
+        {
+            return API_ERROR_CODE_UPDATE_REFLEX_FAILED;
+        }
+        break;
+    }
+    case API_REFLEX_VARIANT_ENABLE:
+    {
+        if (token->i32 < 0 || token->i32 > 1)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        digital_reflex_enable(token->i32 == 1);
+        break;
+    }
+    case API_REFLEX_VARIANT_DELETE:
+    {
+        if (command_line->token_count == 0)
+        {
+            digital_reflex_delete_all();
+            break;
+        }
+        if (token->i32 < 1 || token->i32 > DIGITAL_REFLEX_RULES_MAX)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        if (digital_reflex_delete_rule((uint8_t)(token->i32 - 1)) != STATUS_OK)
+        {
+            return API_ERROR_CODE_UPDATE_REFLEX_FAILED;
+        }
+        break;
+    }
+    case API_REFLEX_VARIANT_SAVE:
+    {
+        if (digital_reflex_save() != STATUS_OK)
+        {
+            return API_ERROR_CODE_SAVE_REFLEX_FAILED;
+        }
+        break;
+    }
+    default:
+        return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+    }
+
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+/**
+ * @brief   cyclic scan engine sampling the inputs, writing the outputs and evaluating the reflex rules on a fixed period
+ *          "W17 <Period>"  start the scan engine with a period in us, or change it, 0 stops the scan engine;
+ *                          while it runs, the writes of "W4" and "W12" are applied at the start of the next cycle
+ *          "W17.1"         clear the statistics
+ *          "R17"           "R17 <Period> <Cycles> <Overruns> <Min> <Avg> <Max> <Max Jitter>", cycle times in us
+ *          "R17.1"         "R17.1 <Count 1> ... <Count 8>", cycles per jitter bucket
+ *                          below 10, 20, 50, 100, 200, 500, 1000 us and above
+ *          "R17.2"         "R17.2 <Cycle> <Input State> <Output State>", process image of the last cycle
+ */
+static uint16_t api_cmd_scan(api_service_context_t *service, command_line_t *command_line)
+{
+    if (command_line->type == 'R')
+    {
+        switch (command_line->variant)
+        {
+        case API_SCAN_VARIANT_STATISTICS:
+        {
+            io_scan_statistics_t statistics;
+            io_scan_get_statistics(&statistics);
+            int32_t values[] = { statistics.period, statistics.cycles, statistics.overruns, statistics.cycle_min,
+                                 statistics.cycle_avg, statistics.cycle_max, statistics.jitter_max };
+            api_respond_values(service, command_line, false, values, ARRAY_SIZE(values));
+            return 0;
+        }
+        case API_SCAN_VARIANT_JITTER:
+        {
+            io_scan_statistics_t statistics;
+            int32_t values[IO_SCAN_JITTER_BUCKET_COUNT];
+            io_scan_get_statistics(&statistics);
+            for (uint8_t i = 0; i < IO_SCAN_JITTER_BUCKET_COUNT; i++)
+            {
+                values[i] = (int32_t)statistics.jitter[i];
+            }
+            api_respond_values(service, command_line, true, values, ARRAY_SIZE(values));
+            return 0;
+        }
+        case API_SCAN_VARIANT_IMAGE:
+        {
+            io_scan_image_t image;
+            io_scan_get_image(&image);
+            api_response_begin(service, 'R', command_line->id);
+            api_response_append_variant(service, command_line->variant);
+            api_response_append_int(service, (int32_t)image.cycle);
+            api_response_append_mask(service, image.inputs);
+            api_response_append_mask(service, image.outputs);
+            api_response_end(service);
+            return 0;
+        }
+        default:
+            return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+        }
+    }
+
+    switch (command_line->variant)
+    {
+    case API_SCAN_VARIANT_STATISTICS:
+    {
+        if (command_line->token->i32 < 0)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        if (command_line->token->i32 == 0)
+        {
+            io_scan_stop();
+        }
+        else if (io_scan_start((uint32_t)command_line->token->i32) != STATUS_OK)
+        {
+            return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+        }
+        break;
+    }
+    case API_SCAN_VARIANT_JITTER:
+    {
+        io_scan_reset_statistics();
+        break;
+    }
+    default:
+        return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+    }
+
+    API_DEFAULT_RESPONSE(service, command_line->type, command_line->id);
+    return 0;
+}
+
+// format: "R101 172 16 0 10"
+// note: ip_address_0 ... ip_address_3 are consecutive bytes in the settings
+static uint16_t api_cmd_ip_address(api_service_context_t *service, command_line_t *command_line)
+{
+    return api_setting_bytes(service, command_line, &settings.ip_address_0, 4, API_ERROR_CODE_UPDATE_IP_FAILED);
+}
+
+// format: "R103 255 240 0 0"
+static uint16_t api_cmd_netmask(api_service_context_t *service, command_line_t *command_line)
+{
+    return api_setting_bytes(service, command_line, &settings.netmask_0, 4, API_ERROR_CODE_UPDATE_NETMASK_FAILED);
+}
+
+// format: "R104 172 16 0 1"
+static uint16_t api_cmd_gateway(api_service_context_t *service, command_line_t *command_line)
+{
+    return api_setting_bytes(service, command_line, &settings.gateway_0, 4, API_ERROR_CODE_UPDATE_GATEWAY_FAILED);
+}
+
+// format: "R105 0 0 0 0 0 0"
+static uint16_t api_cmd_mac_address(api_service_context_t *service, command_line_t *command_line)
+{
+    return api_setting_bytes(service, command_line, &settings.mac_address_0, 6, API_ERROR_CODE_UPDATE_MAC_ADDRESS_FAILED);
+}
+
+// format: "R102 0", the port is an offset to the default port 8500
+static uint16_t api_cmd_tcp_port(api_service_context_t *service, command_line_t *command_line)
+{
+    if (command_line->type == 'R')
+    {
+        int32_t port = settings.tcp_port;
+        api_respond_values(service, command_line, false, &port, 1);
+        return 0;
+    }
+
+    // write the Ethernet port
+    settings.tcp_port = (uint8_t)(command_line->token->i32);
+    return api_save_settings(service, command_line, API_ERROR_CODE_UPDATE_TCP_PORT_FAILED);
+}
+
+// format: "R106.<UART Index> 115200"
+static uint16_t api_cmd_baud_rate(api_service_context_t *service, command_line_t *command_line)
+{
+    // assert if variant is valid
+    if (command_line->variant >= UART_MAX)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_VARIANT;
+    }
+
+    if (command_line->type == 'R')
+    {
+        int32_t baudrate = settings.uart[command_line->variant].baudrate;
+        api_respond_values(service, command_line, true, &baudrate, 1);
+        return 0;
+    }
+
+    // write the baud rate
+    settings.uart[command_line->variant].baudrate = (uint32_t)(command_line->token->i32);
+    return api_save_settings(service, command_line, API_ERROR_CODE_UPDATE_BAUD_RATE_FAILED);
+}
+
+// read format: "R112" responds "R112 <Time 1> ... <Time N>"
+// write format: "W112 <Input Index> <Time>", the input index -1 sets all inputs, the time is in ms (0 - 255)
+static uint16_t api_cmd_debounce(api_service_context_t *service, command_line_t *command_line)
+{
+    if (command_line->type == 'R')
+    {
+        int32_t values[DIGITAL_INPUT_MAX];
+        for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++)
+        {
+            values[i] = settings.debounce[i];
+        }
+        api_respond_values(service, command_line, false, values, DIGITAL_INPUT_MAX);
+        return 0;
+    }
+
+    int32_t input_index = command_line->token->i32;
+    int32_t time = command_line->token->next->i32;
+    if ((input_index != -1 && (input_index < 1 || input_index > DIGITAL_INPUT_MAX)) || time < 0 || time > UINT8_MAX)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_PARAMETER;
+    }
+
+    for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++)
+    {
+        if (input_index == -1 || input_index == i + 1)
+        {
+            settings.debounce[i] = (uint8_t)time;
+            digital_input_set_debounce(i, (uint8_t)time);
+        }
+    }
+    return api_save_settings(service, command_line, API_ERROR_CODE_UPDATE_DEBOUNCE_FAILED);
+}
+
+// echo a command which is not registered, used for debugging in text protocol
+uint16_t api_command_unknown(api_service_context_t *service, command_line_t *command_line)
+{
+    if (service->protocol == API_PROTOCOL_BINARY)
+    {
+        return API_ERROR_CODE_INVALID_COMMAND_ID;
+    }
+
+    // debug print the command
+    LOG_DBG("Command: %c.%d \r\n", command_line->type, command_line->id);
+    api_response_begin(service, command_line->type, command_line->id);
+    if (command_line->variant > 0)
+    {
+        LOG_DBG("Variant: %d \r\n", command_line->variant);
+        api_response_append_variant(service, command_line->variant);
+    }
+    api_response_end(service);
+
+    // print the parameters
+    int32_t length = 0;
+    for (token_t *token = command_line->token; token != NULL; token = token->next)
+    {
+        if (token->type == TOKEN_TYPE_LENGTH)
+        {
+            length = token->i32;
+            LOG_DBG("Length: %d \r\n", length);
+        }
+        else if (token->value_type == PARAM_TYPE_INT32)
+        {
+            LOG_DBG("Param: %d \r\n", token->i32);
+        }
+        else if (token->value_type == PARAM_TYPE_FLOAT)
+        {
+            LOG_DBG("Param: %f \r\n", (double)token->f);
+        }
+        else // PARAM_TYPE_ANY
+        {
+            LOG_DBG("Param: %.*s \r\n", length, (char*)token->any);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,217 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(digital_capture, LOG_LEVEL_DBG);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "stm32f7xx_remote_io.h"
+#include "digital_capture.h"
+#include "digital_input.h"
+#include "utils.h"
+
+#define DIGITAL_CAPTURE_BUFFER_SIZE CONFIG_REMOTEIO_DIGITAL_CAPTURE_BUFFER_SIZE
+
+BUILD_ASSERT(IS_POWER_OF_TWO(DIGITAL_CAPTURE_BUFFER_SIZE),
+	     "CONFIG_REMOTEIO_DIGITAL_CAPTURE_BUFFER_SIZE must be a power of two");
+// records are never split at the end of the buffer
+BUILD_ASSERT(DIGITAL_CAPTURE_BUFFER_SIZE % sizeof(digital_capture_record_t) == 0);
+// a record holds the state of all inputs
+BUILD_ASSERT(DIGITAL_INPUT_MAX <= 16);
+
+/* private functions */
+static void digital_capture_sample(struct k_timer *timer);
+
+/* variables */
+// the client owning the capture, NULL if the capture is free
+static atomic_ptr_t captureOwner = ATOMIC_PTR_INIT(NULL);
+static digital_input_notify_fn_t captureNotify;
+static digital_capture_config_t captureConfig;
+static atomic_t captureState = ATOMIC_INIT(DIGITAL_CAPTURE_STATE_IDLE);
+static atomic_t captureSamples = ATOMIC_INIT(0); // samples recorded since the trigger
+static atomic_t captureDropped = ATOMIC_INIT(0); // records lost because the buffer was full
+static atomic_t capturePending = ATOMIC_INIT(0); // set while the owner has been notified but not read yet
+
+// state only used by the timer
+static uint32_t capturePrevious; // previous sample, used by the edge trigger
+static digital_capture_record_t captureRecord; // run of samples being recorded
+
+// run-length records, produced by the timer and consumed by the owner's thread
+static uint8_t captureBuffer[DIGITAL_CAPTURE_BUFFER_SIZE];
+static utils_ring_t captureRing;
+
+K_TIMER_DEFINE(digital_capture_timer, digital_capture_sample, NULL);
+
+// wake up the owner, once until it reads the records
+static void digital_capture_notify(void)
+{
+	if (atomic_set(&capturePending, 1) == 0 && captureNotify != NULL) {
+		captureNotify(atomic_ptr_get(&captureOwner));
+	}
+}
+
+// move the current record into the buffer
+static void digital_capture_push(void)
+{
+	if (captureRecord.count == 0) {
+		return;
+	}
+
+	if (utils_ring_space(&captureRing) < sizeof(captureRecord)) {
+		atomic_inc(&captureDropped);
+	} else {
+		digital_capture_record_t record = {
+			.state = sys_cpu_to_le16(captureRecord.state),
+			.count = sys_cpu_to_le16(captureRecord.count),
+		};
+		utils_ring_push(&captureRing, (const uint8_t *)&record, sizeof(record));
+	}
+	captureRecord.count = 0;
+	digital_capture_notify();
+}
+
+// sample all inputs, called by the timer in interrupt context
+static void digital_capture_sample(struct k_timer *timer)
+{
+	uint32_t sample = digital_input_read_all();
+
+	if (atomic_get(&captureState) == DIGITAL_CAPTURE_STATE_ARMED) {
+		bool triggered = ((sample & captureConfig.trigger_mask) == captureConfig.trigger_value) &&
+				 (captureConfig.trigger_edges == 0 ||
+				  ((sample ^ capturePrevious) & captureConfig.trigger_edges) != 0);
+		capturePrevious = sample;
+		if (!triggered) {
+			return;
+		}
+		captureRecord.state = (uint16_t)sample;
+		captureRecord.count = 0;
+		atomic_set(&captureState, DIGITAL_CAPTURE_STATE_RUNNING);
+	} else if (atomic_get(&captureState) != DIGITAL_CAPTURE_STATE_RUNNING) {
+		return;
+	}
+
+	// extend the current run, or start a new one if the state changed or the count is full
+	if ((uint16_t)sample != captureRecord.state || captureRecord.count == UINT16_MAX) {
+		digital_capture_push();
+		captureRecord.state = (uint16_t)sample;
+	}
+	captureRecord.count++;
+
+	if ((uint32_t)atomic_inc(&captureSamples) + 1 >= captureConfig.samples) {
+		k_timer_stop(timer);
+		digital_capture_push();
+		atomic_set(&captureState, DIGITAL_CAPTURE_STATE_DONE);
+		digital_capture_notify();
+	}
+}
+
+/**
+ * @brief   start a capture of all digital inputs, only one client can capture at a time
+ *          the inputs are sampled by a timer until the trigger matches, then the given number of
+ *          samples is recorded as runs of identical samples; the client is notified when
+ *          records are ready, see digital_capture_read()
+ * @param   user_data  the client, e.g. a connection, passed to notify
+ * @param   notify     called when records are ready or the capture is done, may be called from interrupt context
+ * @param   config     sample period, number of samples and trigger
+ * @return  STATUS_ERROR if the configuration is invalid, e.g. the period is not a whole number of system ticks,
+ *          or another client is capturing
+ */
+io_status_t digital_capture_start(void *user_data, digital_input_notify_fn_t notify,
+				  const digital_capture_config_t *config)
+{
+	if (user_data == NULL || config == NULL || config->samples == 0 ||
+	    config->period < DIGITAL_CAPTURE_PERIOD_MIN || config->period > DIGITAL_CAPTURE_PERIOD_MAX ||
+	    ((config->trigger_mask | config->trigger_edges) & ~BIT_MASK(DIGITAL_INPUT_MAX)) ||
+	    (config->trigger_value & ~config->trigger_mask)) {
+		return STATUS_ERROR;
+	}
+
+	// the sample counts of the records are only exact if the timer does not stretch the period
+	uint32_t ticks = k_us_to_ticks_near32(config->period);
+	if (ticks == 0 || k_ticks_to_us_near32(ticks) != config->period) {
+		LOG_ERR("Capture period %u us is not a multiple of the system tick", config->period);
+		return STATUS_ERROR;
+	}
+
+	// a client can restart its own capture
+	if (!atomic_ptr_cas(&captureOwner, NULL, user_data) && atomic_ptr_get(&captureOwner) != user_data) {
+		return STATUS_ERROR;
+	}
+
+	k_timer_stop(&digital_capture_timer);
+	utils_ring_init(&captureRing, captureBuffer, sizeof(captureBuffer));
+	captureNotify = notify;
+	captureConfig = *config;
+	captureRecord.count = 0;
+	capturePrevious = digital_input_read_all();
+	atomic_clear(&captureSamples);
+	atomic_clear(&captureDropped);
+	atomic_clear(&capturePending);
+	atomic_set(&captureState, DIGITAL_CAPTURE_STATE_ARMED);
+	k_timer_start(&digital_capture_timer, K_USEC(config->period), K_USEC(config->period));
+
+	LOG_DBG("Capture started, period %u us, %u samples", config->period, config->samples);
+	return STATUS_OK;
+}
+
+// stop the capture of a client, the records recorded so far can still be read
+void digital_capture_stop(void *user_data)
+{
+	if (user_data == NULL || atomic_ptr_get(&captureOwner) != user_data) {
+		return;
+	}
+
+	k_timer_stop(&digital_capture_timer);
+	if (atomic_get(&captureState) == DIGITAL_CAPTURE_STATE_DONE) {
+		return;
+	}
+	digital_capture_push();
+	atomic_set(&captureState, DIGITAL_CAPTURE_STATE_DONE);
+	digital_capture_notify();
+}
+
+// stop the capture of a client and free the capture for other clients, e.g. when the connection is closed
+void digital_capture_release(void *user_data)
+{
+	if (user_data == NULL || atomic_ptr_get(&captureOwner) != user_data) {
+		return;
+	}
+
+	k_timer_stop(&digital_capture_timer);
+	atomic_set(&captureState, DIGITAL_CAPTURE_STATE_IDLE);
+	captureNotify = NULL;
+	atomic_ptr_clear(&captureOwner);
+}
+
+// check if a client owns the capture
+bool digital_capture_is_owner(void *user_data)
+{
+	return user_data != NULL && atomic_ptr_get(&captureOwner) == user_data;
+}
+
+/**
+ * @brief   read the recorded runs, called from the owner's thread
+ *          each record is a digital_capture_record_t in little-endian
+ * @param   user_data  the client owning the capture
+ * @param   data       destination of the records
+ * @param   length     size of data in bytes, only whole records are read
+ * @return  number of bytes read
+ */
+uint32_t digital_capture_read(void *user_data, uint8_t *data, uint32_t length)
+{
+	if (!digital_capture_is_owner(user_data)) {
+		return 0;
+	}
+
+	// records pushed from now on notify the owner again
+	atomic_clear(&capturePending);
+	length -= length % sizeof(digital_capture_record_t);
+	return utils_ring_pop(&captureRing, data, length);
+}
+
+void digital_capture_get_status(digital_capture_status_t *status)
+{
+	status->state = (uint8_t)atomic_get(&captureState);
+	status->samples = (uint32_t)atomic_get(&captureSamples);
+	status->dropped = (uint32_t)atomic_get(&captureDropped);
+}
@@ -0,0 +1,181 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(digital_counter, LOG_LEVEL_DBG);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/math_extras.h>
+
+#include "stm32f7xx_remote_io.h"
+#include "digital_counter.h"
+#include "digital_input.h"
+
+/* private functions */
+static void digital_counter_gate_expiry(struct k_timer *timer);
+
+/* variables */
+// edge counters of the digital inputs, fed by digital_input.c from the edge interrupt,
+// or from the 1 ms scan for inputs without an interrupt
+static uint64_t counters[DIGITAL_INPUT_MAX];
+// bit masks of the inputs counting rising and falling edges
+static atomic_t risingInputs = ATOMIC_INIT(0);
+static atomic_t fallingInputs = ATOMIC_INIT(0);
+// protects the counters, taken from interrupt context
+static struct k_spinlock counterLock;
+
+// frequency measurement, the counters are sampled at the end of each gate time
+static uint16_t gateTime = DIGITAL_COUNTER_GATE_TIME_DEFAULT; // ms
+static uint32_t gateStart; // cycle counter at the start of the gate
+static uint64_t gateCounters[DIGITAL_INPUT_MAX]; // counters at the start of the gate
+static uint32_t frequency[DIGITAL_INPUT_MAX]; // edges per second of the last gate in mHz
+
+K_TIMER_DEFINE(digital_counter_gate_timer, digital_counter_gate_expiry, NULL);
+
+// count the edges of the inputs, rising and falling are bit masks of the inputs with such an edge
+// note: this function may be called from interrupt context
+void digital_counter_count(uint32_t rising, uint32_t falling)
+{
+	uint32_t counted = (rising & (uint32_t)atomic_get(&risingInputs)) |
+			   (falling & (uint32_t)atomic_get(&fallingInputs));
+	if (counted == 0) {
+		return;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&counterLock);
+	while (counted != 0) {
+		counters[u32_count_trailing_zeros(counted)]++;
+		counted &= counted - 1;
+	}
+	k_spin_unlock(&counterLock, key);
+}
+
+// get the bit mask of the inputs with an enabled counter
+uint32_t digital_counter_inputs(void)
+{
+	return (uint32_t)(atomic_get(&risingInputs) | atomic_get(&fallingInputs));
+}
+
+// select the edges counted by the counter of an input, see DIGITAL_COUNTER_MODE_*
+io_status_t digital_counter_set_mode(uint8_t index, uint8_t mode)
+{
+	if (index >= DIGITAL_INPUT_MAX || mode > DIGITAL_COUNTER_MODE_BOTH) {
+		return STATUS_ERROR;
+	}
+
+	bool idle = (digital_counter_inputs() == 0);
+
+	k_spinlock_key_t key = k_spin_lock(&counterLock);
+	if (mode & DIGITAL_COUNTER_MODE_RISING) {
+		atomic_set_bit(&risingInputs, index);
+	} else {
+		atomic_clear_bit(&risingInputs, index);
+	}
+	if (mode & DIGITAL_COUNTER_MODE_FALLING) {
+		atomic_set_bit(&fallingInputs, index);
+	} else {
+		atomic_clear_bit(&fallingInputs, index);
+	}
+	gateCounters[index] = counters[index];
+	frequency[index] = 0;
+	k_spin_unlock(&counterLock, key);
+
+	// the gate timer only runs while a counter is enabled
+	if (digital_counter_inputs() == 0) {
+		k_timer_stop(&digital_counter_gate_timer);
+	} else if (idle) {
+		gateStart = k_cycle_get_32();
+		k_timer_start(&digital_counter_gate_timer, K_MSEC(gateTime), K_MSEC(gateTime));
+	}
+
+	// a single-edge counter only takes the interrupt of its edge,
+	// inputs without an interrupt are counted by the digital input task
+	digital_input_set_irq_edges(index, (mode & DIGITAL_COUNTER_MODE_RISING) != 0,
+				    (mode & DIGITAL_COUNTER_MODE_FALLING) != 0);
+	digital_input_wake_up();
+	return STATUS_OK;
+}
+
+uint8_t digital_counter_get_mode(uint8_t index)
+{
+	if (index >= DIGITAL_INPUT_MAX) {
+		return DIGITAL_COUNTER_MODE_OFF;
+	}
+	return (atomic_test_bit(&risingInputs, index) ? DIGITAL_COUNTER_MODE_RISING : 0) |
+	       (atomic_test_bit(&fallingInputs, index) ? DIGITAL_COUNTER_MODE_FALLING : 0);
+}
+
+// read the counter of an input, and clear it at the same time if requested
+uint64_t digital_counter_read(uint8_t index, bool clear)
+{
+	if (index >= DIGITAL_INPUT_MAX) {
+		return 0;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&counterLock);
+	uint64_t count = counters[index];
+	if (clear) {
+		// keep the running gate consistent
+		gateCounters[index] -= count;
+		counters[index] = 0;
+	}
+	k_spin_unlock(&counterLock, key);
+	return count;
+}
+
+// set the gate time of the frequency measurement in ms
+io_status_t digital_counter_set_gate_time(uint16_t gate_time)
+{
+	if (gate_time < DIGITAL_COUNTER_GATE_TIME_MIN || gate_time > DIGITAL_COUNTER_GATE_TIME_MAX) {
+		return STATUS_ERROR;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&counterLock);
+	gateTime = gate_time;
+	gateStart = k_cycle_get_32();
+	for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++) {
+		gateCounters[i] = counters[i];
+	}
+	k_spin_unlock(&counterLock, key);
+
+	if (digital_counter_inputs() != 0) {
+		k_timer_start(&digital_counter_gate_timer, K_MSEC(gate_time), K_MSEC(gate_time));
+	}
+	return STATUS_OK;
+}
+
+uint16_t digital_counter_get_gate_time(void)
+{
+	return gateTime;
+}
+
+// get the frequency of the counted edges of an input over the last gate time in mHz
+uint32_t digital_counter_get_frequency(uint8_t index)
+{
+	if (index >= DIGITAL_INPUT_MAX) {
+		return 0;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&counterLock);
+	uint32_t value = frequency[index];
+	k_spin_unlock(&counterLock, key);
+	return value;
+}
+
+// runs in interrupt context at the end of each gate time
+static void digital_counter_gate_expiry(struct k_timer *timer)
+{
+	k_spinlock_key_t key = k_spin_lock(&counterLock);
+
+	// measure the actual gate time with the cycle counter
+	uint32_t now = k_cycle_get_32();
+	uint32_t elapsed = now - gateStart;
+	gateStart = now;
+
+	for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++) {
+		uint64_t edges = counters[i] - gateCounters[i];
+		gateCounters[i] = counters[i];
+		frequency[i] = (elapsed == 0) ? 0 :
+			(uint32_t)MIN(edges * 1000ULL * sys_clock_hw_cycles_per_sec() / elapsed, UINT32_MAX);
+	}
+
+	k_spin_unlock(&counterLock, key);
+}
@@ -9,26 +9,76 @@ LOG_MODULE_REGISTER(digital_input, LOG_LEVEL_DBG);
 
 #include "stm32f7xx_remote_io.h"
 #include "digital_input.h"
+#include "digital_counter.h"
+#include "digital_reflex.h"
+#include "io_scan.h"
+#include "settings.h"
 
 #define DIGITAL_INPUT_UPDATE_INTERVAL 1 // ms
+#define DIGITAL_INPUT_WAKE_UP DIGITAL_INPUT_MAX // edge index that only wakes the task up
+#define DIGITAL_INPUT_DEBOUNCE_BITS 8 // width of the debounce counters, up to 255 ms
+
+#define DIGITAL_INPUT_SUBSCRIBER_MAX CONFIG_REMOTEIO_DIGITAL_INPUT_SUBSCRIBERS
+#define DIGITAL_INPUT_EVENT_MAX CONFIG_REMOTEIO_DIGITAL_INPUT_EVENTS
+
+BUILD_ASSERT(IS_POWER_OF_TWO(DIGITAL_INPUT_EVENT_MAX), "CONFIG_REMOTEIO_DIGITAL_INPUT_EVENTS must be a power of two");
 
 /* type definition */
-typedef struct ServiceNode {
-	struct ServiceNode *next;
-    digital_input_callback_fn_t cb;
-	void *user_data;
-} service_node_t;
-
-typedef struct NodeSubscribedInputs {
-	struct NodeSubscribedInputs *next;
+// a client subscribed to digital inputs, e.g. a connection
+// events are written by the task and read by the client's own thread
+typedef struct DigitalInputSubscriber {
+	atomic_ptr_t user_data; // NULL if the slot is free
+	atomic_t mask; // bit mask of the subscribed inputs
+	digital_input_notify_fn_t notify; // called after events are queued
+	bool coalesced; // queue the changes of a window as one event
+	uint16_t window; // coalescing window in ms
+	// event ring, single producer (task) and single consumer (client)
+	digital_input_event_t events[DIGITAL_INPUT_EVENT_MAX];
+	atomic_t head; // next event to write
+	atomic_t tail; // next event to read
+	atomic_t dropped; // events lost because the ring was full
+	// state only used by the task
+	uint32_t sequence; // sequence number of the next event
+	uint32_t pending; // inputs changed since the last coalesced event
+	uint32_t deadline; // uptime in ms when the pending changes are queued
+	uint32_t timestamp; // time of the last pending change in us
+} digital_input_subscriber_t;
+
+typedef struct DigitalInputEdge {
+	uint32_t timestamp; // cycle counter when the edge was detected
+	uint8_t index; // index of the input or DIGITAL_INPUT_WAKE_UP
+	bool state; // state of the input after the edge
+} digital_input_edge_t;
+
+// a GPIO port with at least one digital input
+typedef struct DigitalInputPort {
+	const struct device *port;
+	gpio_port_pins_t active_low; // pins whose raw level is inverted
+} digital_input_port_t;
+
+// digital inputs whose pin number is their index plus the same offset on the same port,
+// they are gathered from the port value with one mask and one shift
+typedef struct DigitalInputRun {
+	gpio_port_pins_t mask; // pins of the run
+	int8_t shift; // pin number minus input index
+	uint8_t port; // index in digitalInputPorts
+} digital_input_run_t;
+
+#if CONFIG_REMOTEIO_DIGITAL_INPUT_IRQ
+typedef struct DigitalInputIrq {
+	struct gpio_callback callback;
 	uint8_t index;
-	bool state;
-	service_node_t *services; // linked list of services
-} node_subscribed_inputs_t;
+} digital_input_irq_t;
+#endif
 
 /* private functions */
 void digital_input_poll_task(void *parameters);
 struct gpio_dt_spec *digital_input_get_gpio_spec(uint8_t index);
+static void digital_input_port_init(void);
+static uint32_t digital_input_subscribed(void);
+#if CONFIG_REMOTEIO_DIGITAL_INPUT_IRQ
+static void digital_input_irq_init(void);
+#endif
 
 /* variables */
 // get gpio spec
@@ -42,7 +92,54 @@ struct gpio_dt_spec *digital_input_get_gpio_spec(uint8_t index);
 // listify the GPIO spec
 LISTIFY(DIGITAL_INPUT_MAX, GET_GPIO_SPEC, (;));
 
-node_subscribed_inputs_t *headNodeSubscribedInputs = NULL;
+static digital_input_subscriber_t digitalInputSubscribers[DIGITAL_INPUT_SUBSCRIBER_MAX];
+
+// state of the subscribed inputs as last notified, only used by the task
+static uint32_t inputState = 0;
+// subscribed inputs known by the task, inputs added later take their state from a snapshot
+static uint32_t inputStateValid = 0;
+
+// port and run tables used to read all inputs at once, see digital_input_read_all()
+static digital_input_port_t digitalInputPorts[DIGITAL_INPUT_MAX];
+static uint8_t digitalInputPortCount = 0;
+static digital_input_run_t digitalInputRuns[DIGITAL_INPUT_MAX];
+static uint8_t digitalInputRunCount = 0;
+
+// debounce filter made of vertical counters:
+// bit i of debounceCount[k] is bit k of the counter of input i, the same for debounceTime
+static uint32_t debounceCount[DIGITAL_INPUT_DEBOUNCE_BITS];
+static uint32_t debounceTime[DIGITAL_INPUT_DEBOUNCE_BITS];
+static uint32_t debounceState = 0; // filtered state of all inputs
+static uint32_t debounceScan = 0; // uptime in ms of the last counted scan, by any caller
+static atomic_t debounceInputs = ATOMIC_INIT(0); // inputs with a debounce time
+static struct k_spinlock debounceLock;
+
+// polled inputs with an enabled counter and their state in the last scan, only used by the task
+static uint32_t counterInputs = 0;
+static uint32_t counterState = 0;
+
+// latched edges of all inputs since the last read, see digital_input_read_latched()
+// set from the edge interrupt, or from the scans of the task for inputs without an interrupt
+static atomic_t latchRising = ATOMIC_INIT(0);
+static atomic_t latchFalling = ATOMIC_INIT(0);
+// state of the inputs without an interrupt in the last scan, only used by the task
+static uint32_t latchState = 0;
+
+// bit mask of the inputs reporting edges by interrupt, the other inputs are polled
+static uint32_t irqInputs = 0;
+// interrupt inputs of a single-edge counter, their interrupt only fires on the counted edge,
+// they are polled for the subscriptions and the latches like inputs without an interrupt
+static atomic_t irqSingleEdge = ATOMIC_INIT(0);
+// set by the ISR if an edge is lost because the queue is full
+static atomic_t edgeQueueOverflow = ATOMIC_INIT(0);
+
+// edges are timestamped in the ISR and handed to the task through this queue
+K_MSGQ_DEFINE(digital_input_edge_queue, sizeof(digital_input_edge_t),
+	      CONFIG_REMOTEIO_DIGITAL_INPUT_EDGE_QUEUE_SIZE, 4);
+
+#if CONFIG_REMOTEIO_DIGITAL_INPUT_IRQ
+static digital_input_irq_t digitalInputIrq[DIGITAL_INPUT_MAX];
+#endif
 
 // used by listify
 #define NOT_DEVICE_IS_READY(id, _)  !device_is_ready(digital_input_##id.port)
@@ -82,49 +179,451 @@ io_status_t digital_input_init()
 		return STATUS_ERROR;
 	}
 
+	digital_input_port_init();
+
+	// apply the debounce times from the settings
+	for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++) {
+		digital_input_set_debounce(i, settings.debounce[i]);
+	}
+
+#if CONFIG_REMOTEIO_DIGITAL_INPUT_IRQ
+	digital_input_irq_init();
+#endif
+
 	return STATUS_OK;
 }
 
-// polling task for monitoring subscribed digital inputs
+// group the digital inputs by port and into runs of the same pin offset
+// e.g. usr_in_1 ... usr_in_7 on PE2 ... PE8 form one run with a shift of 1
+static void digital_input_port_init(void)
+{
+	for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++) {
+		struct gpio_dt_spec *spec = digital_input_get_gpio_spec(i);
+		uint8_t port = 0;
+		uint8_t run = 0;
+		int8_t shift = (int8_t)spec->pin - (int8_t)i;
+
+		// find or add the port
+		while (port < digitalInputPortCount && digitalInputPorts[port].port != spec->port) {
+			port++;
+		}
+		if (port == digitalInputPortCount) {
+			digitalInputPorts[port].port = spec->port;
+			digitalInputPorts[port].active_low = 0;
+			digitalInputPortCount++;
+		}
+		if (spec->dt_flags & GPIO_ACTIVE_LOW) {
+			digitalInputPorts[port].active_low |= BIT(spec->pin);
+		}
+
+		// find or add the run
+		while (run < digitalInputRunCount &&
+		       (digitalInputRuns[run].port != port || digitalInputRuns[run].shift != shift)) {
+			run++;
+		}
+		if (run == digitalInputRunCount) {
+			digitalInputRuns[run].port = port;
+			digitalInputRuns[run].shift = shift;
+			digitalInputRuns[run].mask = 0;
+			digitalInputRunCount++;
+		}
+		digitalInputRuns[run].mask |= BIT(spec->pin);
+	}
+	LOG_INF("Digital inputs: %d ports, %d runs", digitalInputPortCount, digitalInputRunCount);
+}
+
+#if CONFIG_REMOTEIO_DIGITAL_INPUT_IRQ
+// runs in interrupt context on both edges of a digital input, or on the counted edge of a single-edge counter
+static void digital_input_edge_isr(const struct device *port, struct gpio_callback *cb,
+				   gpio_port_pins_t pins)
+{
+	digital_input_irq_t *irq = CONTAINER_OF(cb, digital_input_irq_t, callback);
+	digital_input_edge_t edge = {
+		.timestamp = k_cycle_get_32(),
+		.index = irq->index,
+	};
+
+	// the interrupt of a single-edge counter is its edge, it is counted without reading the pin,
+	// so a pulse shorter than the interrupt latency is still counted
+	if (atomic_test_bit(&irqSingleEdge, irq->index)) {
+		digital_counter_count(BIT(irq->index), BIT(irq->index));
+		return;
+	}
+
+	// a counter of both edges takes each interrupt as one edge whatever the pin reads;
+	// a pulse may be over before the pin is read, then both edges are latched as falling
+	edge.state = gpio_pin_get_dt(digital_input_get_gpio_spec(irq->index)) > 0;
+	digital_counter_count(edge.state ? BIT(irq->index) : 0, edge.state ? 0 : BIT(irq->index));
+	atomic_or(edge.state ? &latchRising : &latchFalling, BIT(irq->index));
+
+	// nobody listens to this input
+	if (!(digital_input_subscribed() & BIT(irq->index))) {
+		return;
+	}
+
+	if (k_msgq_put(&digital_input_edge_queue, &edge, K_NO_WAIT) != 0) {
+		atomic_set(&edgeQueueOverflow, 1);
+	}
+}
+
+// enable edge interrupts on all digital inputs
+// note: pins with the same number on different ports share one EXTI line on STM32,
+// only the first of them gets the interrupt and the others keep being polled.
+static void digital_input_irq_init(void)
+{
+	for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++) {
+		struct gpio_dt_spec *spec = digital_input_get_gpio_spec(i);
+
+		digitalInputIrq[i].index = i;
+		gpio_init_callback(&digitalInputIrq[i].callback, digital_input_edge_isr, BIT(spec->pin));
+
+		if (gpio_pin_interrupt_configure_dt(spec, GPIO_INT_EDGE_BOTH) < 0) {
+			LOG_WRN("No interrupt for digital input %d, polling it", i);
+			continue;
+		}
+		if (gpio_add_callback(spec->port, &digitalInputIrq[i].callback) < 0) {
+			LOG_WRN("No interrupt for digital input %d, polling it", i);
+			gpio_pin_interrupt_configure_dt(spec, GPIO_INT_DISABLE);
+			continue;
+		}
+		irqInputs |= BIT(i);
+	}
+	LOG_INF("Digital input interrupts: 0x%04x", irqInputs);
+}
+#endif
+
+/**
+ * @brief   select the edges raising the interrupt of a digital input, called when its counter mode changes
+ *          a single-edge counter gets an interrupt on the counted edge only, other inputs on both edges
+ * @param   to_active    the counter counts the edges to the active state
+ * @param   to_inactive  the counter counts the edges to the inactive state
+ */
+void digital_input_set_irq_edges(uint8_t index, bool to_active, bool to_inactive)
+{
+#if CONFIG_REMOTEIO_DIGITAL_INPUT_IRQ
+	if (index >= DIGITAL_INPUT_MAX || !(irqInputs & BIT(index))) {
+		return;
+	}
+
+	struct gpio_dt_spec *spec = digital_input_get_gpio_spec(index);
+	if (to_active != to_inactive) {
+		// the edge is selected before the ISR stops reading the pin
+		if (gpio_pin_interrupt_configure_dt(spec, to_active ? GPIO_INT_EDGE_TO_ACTIVE
+								    : GPIO_INT_EDGE_TO_INACTIVE) < 0) {
+			LOG_ERR("Failed to configure the interrupt of digital input %d", index);
+			return;
+		}
+		atomic_set_bit(&irqSingleEdge, index);
+	} else {
+		// the ISR reads the pin again before both edges raise the interrupt
+		atomic_clear_bit(&irqSingleEdge, index);
+		if (gpio_pin_interrupt_configure_dt(spec, GPIO_INT_EDGE_BOTH) < 0) {
+			LOG_ERR("Failed to configure the interrupt of digital input %d", index);
+		}
+	}
+#endif
+}
+
+/**
+ * @brief   debounce all inputs at once
+ *          an input takes a new state after its raw state differed from the filtered state
+ *          in as many consecutive counted scans as its debounce time, inputs without a debounce time pass;
+ *          the scans of the digital input task and of the scan engine feed the same filter
+ * @param   raw     state of all inputs read in this scan
+ * @param   now     uptime in ms, only the first scan of each millisecond is counted
+ * @return  filtered state of all inputs
+ */
+uint32_t digital_input_debounce(uint32_t raw, uint32_t now)
+{
+	k_spinlock_key_t key = k_spin_lock(&debounceLock);
+	uint32_t filtered = (uint32_t)atomic_get(&debounceInputs);
+
+	if (now != debounceScan) {
+		debounceScan = now;
+		uint32_t differ = (raw ^ debounceState) & filtered;
+		uint32_t carry = differ;
+		uint32_t equal = UINT32_MAX;
+
+		// increment the counters of differing inputs, clear the others
+		for (uint8_t k = 0; k < DIGITAL_INPUT_DEBOUNCE_BITS; k++) {
+			uint32_t bit = debounceCount[k];
+			debounceCount[k] = (bit ^ carry) & differ;
+			carry &= bit;
+			equal &= ~(debounceCount[k] ^ debounceTime[k]);
+		}
+
+		// toggle the inputs whose counter reached the debounce time
+		uint32_t reached = equal & differ;
+		debounceState ^= reached;
+		for (uint8_t k = 0; k < DIGITAL_INPUT_DEBOUNCE_BITS; k++) {
+			debounceCount[k] &= ~reached;
+		}
+	}
+	debounceState = (debounceState & filtered) | (raw & ~filtered);
+
+	uint32_t state = debounceState;
+	k_spin_unlock(&debounceLock, key);
+	return state;
+}
+
+// restart the filter of some inputs from their raw state
+static void digital_input_debounce_reset(uint32_t mask, uint32_t raw)
+{
+	k_spinlock_key_t key = k_spin_lock(&debounceLock);
+	debounceState = (debounceState & ~mask) | (raw & mask);
+	for (uint8_t k = 0; k < DIGITAL_INPUT_DEBOUNCE_BITS; k++) {
+		debounceCount[k] &= ~mask;
+	}
+	k_spin_unlock(&debounceLock, key);
+}
+
+/**
+ * @brief   set the debounce time of a digital input
+ * @note    debounced inputs are sampled every millisecond while they are subscribed or used by the reflex rules,
+ *          also while the scan engine runs, the edges reported by their interrupt are ignored
+ * @param   time    number of consecutive 1 ms scans a new state must be stable, 0 disables the filter
+ */
+void digital_input_set_debounce(uint8_t index, uint8_t time)
+{
+	if (index >= DIGITAL_INPUT_MAX) {
+		return;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&debounceLock);
+	for (uint8_t k = 0; k < DIGITAL_INPUT_DEBOUNCE_BITS; k++) {
+		WRITE_BIT(debounceTime[k], index, (time >> k) & 0x01);
+		debounceCount[k] &= ~BIT(index);
+	}
+	if (time > 0) {
+		atomic_set_bit(&debounceInputs, index);
+	} else {
+		atomic_clear_bit(&debounceInputs, index);
+	}
+	k_spin_unlock(&debounceLock, key);
+
+	// wake the task to recompute its timeout
+	digital_input_wake_up();
+}
+
+// wake the task up to recompute which inputs are polled, e.g. after a subscription
+void digital_input_wake_up(void)
+{
+	digital_input_edge_t wake_up = { .index = DIGITAL_INPUT_WAKE_UP };
+	(void)k_msgq_put(&digital_input_edge_queue, &wake_up, K_NO_WAIT);
+}
+
+// get the bit mask of the inputs subscribed by any client
+static uint32_t digital_input_subscribed(void)
+{
+	uint32_t mask = 0;
+	for (uint8_t i = 0; i < DIGITAL_INPUT_SUBSCRIBER_MAX; i++) {
+		mask |= (uint32_t)atomic_get(&digitalInputSubscribers[i].mask);
+	}
+	return mask;
+}
+
+// queue an event for a subscriber without blocking, the event is counted as dropped if the ring is full
+static void digital_input_queue_event(digital_input_subscriber_t *subscriber, uint32_t changed,
+				      uint32_t state, uint32_t timestamp, bool coalesced)
+{
+	atomic_val_t head = atomic_get(&subscriber->head);
+	uint32_t sequence = subscriber->sequence++;
+
+	if ((uint32_t)(head - atomic_get(&subscriber->tail)) >= DIGITAL_INPUT_EVENT_MAX) {
+		atomic_inc(&subscriber->dropped);
+		return;
+	}
+
+	digital_input_event_t *event = &subscriber->events[head & (DIGITAL_INPUT_EVENT_MAX - 1)];
+	event->timestamp = timestamp;
+	event->sequence = sequence;
+	event->changed = changed;
+	event->state = state;
+	event->coalesced = coalesced;
+	// publish the event after it is written
+	atomic_set(&subscriber->head, head + 1);
+}
+
+/**
+ * @brief   convert a cycle count taken within the last wrap of the 32-bit cycle counter to us since boot
+ *          the cycle counter wraps every 2^32 cycles, e.g. every 19.9 s at 216 MHz, so it is extended
+ *          to 64 bits with the uptime in ticks; the result wraps every 2^32 us, so clients can unwrap it
+ * @param   cycles  cycle counter when the change was detected
+ * @return  us since boot, truncated to 32 bits
+ */
+static uint32_t digital_input_cycles_to_us(uint32_t cycles)
+{
+	// one tick behind, the uptime stays below the cycle count read after it
+	int64_t ticks = MAX(k_uptime_ticks() - 1, 0);
+	uint32_t now_cycles = k_cycle_get_32();
+	uint64_t base = (uint64_t)ticks * k_ticks_to_cyc_floor64(1);
+	uint64_t now = base + (uint32_t)(now_cycles - (uint32_t)base);
+
+	return (uint32_t)k_cyc_to_us_floor64(now - (uint32_t)(now_cycles - cycles));
+}
+
+// queue the changed inputs to each subscriber and wake the subscribers up
+// subscribers in coalesced mode collect the changes until digital_input_flush()
+static void digital_input_dispatch(uint32_t changed, uint32_t timestamp)
+{
+	uint32_t time_us = digital_input_cycles_to_us(timestamp);
+
+	for (uint8_t i = 0; i < DIGITAL_INPUT_SUBSCRIBER_MAX; i++) {
+		digital_input_subscriber_t *subscriber = &digitalInputSubscribers[i];
+		uint32_t mask = (uint32_t)atomic_get(&subscriber->mask);
+		uint32_t bits = changed & mask;
+		void *user_data = atomic_ptr_get(&subscriber->user_data);
+
+		if (bits == 0 || user_data == NULL) {
+			continue;
+		}
+
+		if (subscriber->coalesced) {
+			// the window starts with the first change
+			if (subscriber->pending == 0) {
+				subscriber->deadline = k_uptime_get_32() + subscriber->window;
+			}
+			subscriber->pending |= bits;
+			subscriber->timestamp = time_us;
+			continue;
+		}
+
+		while (bits != 0) {
+			uint32_t bit = bits & -bits;
+			bits &= bits - 1;
+			digital_input_queue_event(subscriber, bit, inputState & mask, time_us, false);
+		}
+		if (subscriber->notify != NULL) {
+			subscriber->notify(user_data);
+		}
+	}
+}
+
+// queue the coalesced changes whose window has elapsed
+// return the time in ms until the next window elapses, or -1 if nothing is pending
+static int32_t digital_input_flush(void)
+{
+	uint32_t now = k_uptime_get_32();
+	int32_t next = -1;
+
+	for (uint8_t i = 0; i < DIGITAL_INPUT_SUBSCRIBER_MAX; i++) {
+		digital_input_subscriber_t *subscriber = &digitalInputSubscribers[i];
+		if (subscriber->pending == 0) {
+			continue;
+		}
+
+		int32_t remaining = (int32_t)(subscriber->deadline - now);
+		if (remaining > 0) {
+			next = (next < 0) ? remaining : MIN(next, remaining);
+			continue;
+		}
+
+		// drop the changes if the subscriber has left in the meantime
+		uint32_t mask = (uint32_t)atomic_get(&subscriber->mask);
+		void *user_data = atomic_ptr_get(&subscriber->user_data);
+		if (user_data != NULL && (subscriber->pending & mask) != 0) {
+			digital_input_queue_event(subscriber, subscriber->pending & mask, inputState & mask,
+						  subscriber->timestamp, true);
+			if (subscriber->notify != NULL) {
+				subscriber->notify(user_data);
+			}
+		}
+		subscriber->pending = 0;
+	}
+	return next;
+}
+
+// task for monitoring subscribed digital inputs
+// edges of interrupt inputs are taken from the queue, the other inputs are polled
 void digital_input_poll_task(void *parameters)
 {
+	digital_input_edge_t edge;
+	int32_t next_flush = -1;
+
 	for (;;) {
-		// check if there is a subscribed digital input
-		if (headNodeSubscribedInputs == NULL) {
-            LOG_DBG("suspend");
-			// suspend the task if there is no subscribed digital input
-			k_thread_suspend(digital_input_polling_task);
+		// sleep until the next edge, or wake up periodically if a polled input is subscribed
+		uint32_t debounced = (uint32_t)atomic_get(&debounceInputs);
+		// the reflex rules are evaluated by the scan engine while it runs, but their debounced inputs
+		// are still filtered every millisecond, so the debounce time does not depend on the scan period
+		bool scanning = io_scan_is_running();
+		uint32_t reflex = scanning ? (digital_reflex_inputs() & debounced) : digital_reflex_inputs();
+		// inputs whose interrupt reports both edges
+		uint32_t edges = irqInputs & ~(uint32_t)atomic_get(&irqSingleEdge);
+		bool polling = (digital_input_subscribed() & (~edges | debounced)) != 0 ||
+			       (digital_counter_inputs() & ~edges) != 0 ||
+			       reflex != 0;
+		k_timeout_t timeout = polling ? K_MSEC(DIGITAL_INPUT_UPDATE_INTERVAL) : K_FOREVER;
+		// or when the next coalescing window elapses
+		if (next_flush >= 0 && (!polling || next_flush < DIGITAL_INPUT_UPDATE_INTERVAL)) {
+			timeout = K_MSEC(next_flush);
+		}
+		bool has_edge = (k_msgq_get(&digital_input_edge_queue, &edge, timeout) == 0);
+
+		// newly subscribed inputs start from their current state without a notification
+		uint32_t subscribed = digital_input_subscribed();
+		uint32_t added = subscribed & ~inputStateValid;
+		inputStateValid = subscribed;
+		if (added != 0) {
+			uint32_t raw = digital_input_read_all();
+			digital_input_debounce_reset(added, raw);
+			inputState = (inputState & ~added) | (raw & added);
 		}
 
-		// check the state of the subscribed digital inputs
-		node_subscribed_inputs_t *current = headNodeSubscribedInputs;
-		bool state = false;
-
-		while (current != NULL) {
-			// read the state of the digital input
-			state = digital_input_read(current->index);
-
-			// check if the state has changed
-			if (state != current->state) {
-				// update the state
-				current->state = state;
-
-				// Notify clients with the format: "S<Service ID> <Input Index>
-				// <State>"
-				// execute the callback function with user data and results for each
-				// subscriber.
-				service_node_t *current_service = current->services;
-				while (current_service != NULL) {
-					current_service->cb(current_service->user_data,
-							    current->index, state);
-					current_service = current_service->next;
+		while (has_edge) {
+			// debounced inputs are sampled below instead
+			if (edge.index != DIGITAL_INPUT_WAKE_UP && !(debounced & BIT(edge.index))) {
+				uint32_t changed = ((edge.state ? BIT(edge.index) : 0) ^ inputState) & BIT(edge.index);
+				if (changed != 0) {
+					inputState ^= changed;
+					digital_input_dispatch(changed, edge.timestamp);
 				}
 			}
-			current = current->next;
+			has_edge = (k_msgq_get(&digital_input_edge_queue, &edge, K_NO_WAIT) == 0);
 		}
 
-		// delay few milliseconds by putting the task to sleep
-		k_sleep(K_MSEC(DIGITAL_INPUT_UPDATE_INTERVAL));
+		// read the interrupt inputs as well if edges have been lost
+		uint32_t polled = ~edges | debounced;
+		if (atomic_set(&edgeQueueOverflow, 0)) {
+			LOG_WRN("Digital input edge queue overflow");
+			polled = UINT32_MAX;
+		}
+
+		// count the edges of the counted inputs without interrupt,
+		// inputs whose counter was just enabled have no previous state yet
+		uint32_t counted = digital_counter_inputs() & ~irqInputs;
+		uint32_t count_edges = counted & counterInputs;
+		counterInputs = counted;
+
+		// compare the polled inputs against one debounced snapshot
+		polled &= subscribed;
+		if (polled != 0 || (digital_counter_inputs() & ~edges) != 0 || reflex != 0) {
+			uint32_t timestamp = k_cycle_get_32();
+			uint32_t raw = digital_input_read_all();
+
+			digital_counter_count(raw & ~counterState & count_edges, ~raw & counterState & count_edges);
+			counterState = raw;
+
+			// latch the edges of the inputs without an interrupt seen between two scans
+			atomic_or(&latchRising, raw & ~latchState & ~edges);
+			atomic_or(&latchFalling, ~raw & latchState & ~edges);
+			latchState = raw;
+
+			// the debounce counters advance once per millisecond
+			uint32_t now = k_uptime_get_32();
+			uint32_t state = digital_input_debounce(raw, now);
+			uint32_t changed = (state ^ inputState) & polled;
+			if (changed != 0) {
+				inputState ^= changed;
+				digital_input_dispatch(changed, timestamp);
+			}
+
+			// the reflex rules react within one scan
+			if (reflex != 0 && !scanning) {
+				digital_reflex_evaluate(state, now);
+			}
+		}
+
+		next_flush = digital_input_flush();
 	}
 }
 
@@ -169,93 +668,104 @@ bool digital_input_read(uint8_t index)
 
 /**
  * @brief   read the state of all digital inputs
+ * @note    each port is read once, so all inputs of a port are sampled at the same time
  * @return  the state of all digital inputs
  *          1/active, 0/inactive
  *          e.g. 0b0000000000000001 = digital input 1 is active
  */
 uint32_t digital_input_read_all()
 {
+	gpio_port_value_t values[DIGITAL_INPUT_MAX];
 	uint32_t data = 0;
-	for (uint8_t i = 0; i < DIGITAL_INPUT_MAX; i++) {
-		data |= (digital_input_read(i) << (i));
+
+	for (uint8_t i = 0; i < digitalInputPortCount; i++) {
+		if (gpio_port_get_raw(digitalInputPorts[i].port, &values[i]) < 0) {
+			LOG_ERR("Failed to read digital input port %d", i);
+			values[i] = digitalInputPorts[i].active_low; // all inactive
+		}
+		values[i] ^= digitalInputPorts[i].active_low;
+	}
+
+	for (uint8_t i = 0; i < digitalInputRunCount; i++) {
+		const digital_input_run_t *run = &digitalInputRuns[i];
+		uint32_t pins = values[run->port] & run->mask;
+		data |= (run->shift >= 0) ? (pins >> run->shift) : (pins << -run->shift);
 	}
 	return data;
 }
 
-// subscribe to a digital input specified by the index
-// to create an event-driven feature for clients.
-void digital_input_subscribe(void *user_data, uint8_t index, digital_input_callback_fn_t callback)
+/**
+ * @brief   read the latched edges of all inputs and clear them
+ *          an edge in either direction means that the input has been active since the last read,
+ *          so pulses shorter than the read interval are reported even if the input is inactive now
+ * @note    inputs without an interrupt, or with the interrupt of a single-edge counter, are only latched
+ *          while the task scans them, i.e. while they are subscribed or counted
+ * @param   rising   bit mask of the inputs with a rising edge since the last read, may be NULL
+ * @param   falling  bit mask of the inputs with a falling edge since the last read, may be NULL
+ * @return  bit mask of the inputs active now or since the last read
+ */
+uint32_t digital_input_read_latched(uint32_t *rising, uint32_t *falling)
 {
-	// make sure the index is valid
-	if (index >= DIGITAL_INPUT_MAX) {
-		return;
+	// read the state first, edges after the read are reported now or by the next read
+	uint32_t state = digital_input_read_all();
+	uint32_t rose = (uint32_t)atomic_clear(&latchRising);
+	uint32_t fell = (uint32_t)atomic_clear(&latchFalling);
+
+	if (rising != NULL) {
+		*rising = rose;
+	}
+	if (falling != NULL) {
+		*falling = fell;
 	}
+	return state | rose | fell;
+}
 
-	// check if it is already subscribed
-	node_subscribed_inputs_t *current = headNodeSubscribedInputs;
-	while (current != NULL) {
-		if (current->index == index) {
-			// check if the service is already registered
-			service_node_t *current_service = current->services;
-            service_node_t *prev_service = NULL;
-			while (current_service != NULL) {
-				if (current_service == user_data) {
-					// service is already registered
-					return;
-				}
-                prev_service = current_service;
-				current_service = current_service->next;
-			}
-			// create a new service node
-			service_node_t *new_service_node =
-				(service_node_t *)malloc(sizeof(service_node_t));
-			if (new_service_node == NULL) {
-				LOG_ERR("Failed to allocate memory for service node");
-				return;
-			}
-			new_service_node->cb = callback;
-			new_service_node->user_data = user_data;
-			new_service_node->next = NULL;
-			// add the service node to the linked list
-            if (prev_service == NULL) {
-                current->services = new_service_node;
-            } else {
-                prev_service->next = new_service_node;
-            }
-			return;
+// find the slot of a subscriber, or claim a free one if requested
+static digital_input_subscriber_t *digital_input_get_subscriber(void *user_data, bool claim)
+{
+	for (uint8_t i = 0; i < DIGITAL_INPUT_SUBSCRIBER_MAX; i++) {
+		if (atomic_ptr_get(&digitalInputSubscribers[i].user_data) == user_data) {
+			return &digitalInputSubscribers[i];
 		}
-		current = current->next;
 	}
+	if (!claim) {
+		return NULL;
+	}
+	for (uint8_t i = 0; i < DIGITAL_INPUT_SUBSCRIBER_MAX; i++) {
+		digital_input_subscriber_t *subscriber = &digitalInputSubscribers[i];
+		if (atomic_ptr_cas(&subscriber->user_data, NULL, user_data)) {
+			// start with an empty ring and one event per input
+			atomic_set(&subscriber->tail, atomic_get(&subscriber->head));
+			atomic_clear(&subscriber->dropped);
+			subscriber->coalesced = false;
+			return subscriber;
+		}
+	}
+	return NULL;
+}
 
-	// create a node for the subscribed digital input
-	node_subscribed_inputs_t *newNode =
-		(node_subscribed_inputs_t *)malloc(sizeof(node_subscribed_inputs_t));
-	if (newNode == NULL) {
-		LOG_ERR("Failed to allocate memory for subscribed digital input node");
-		return;
+// subscribe to a digital input specified by the index
+// to create an event-driven feature for clients.
+// the notify function is called from the digital input task after events are queued,
+// it must not block, e.g. post an event to the client's thread which reads the events
+io_status_t digital_input_subscribe(void *user_data, uint8_t index, digital_input_notify_fn_t notify)
+{
+	// make sure the index is valid
+	if (index >= DIGITAL_INPUT_MAX || user_data == NULL) {
+		return STATUS_ERROR;
 	}
-	newNode->index = index;
-	newNode->next = NULL;
-	newNode->services = NULL;
-	// create a new service node
-	service_node_t *new_service_node = (service_node_t *)malloc(sizeof(service_node_t));
-	if (new_service_node == NULL) {
-		LOG_ERR("Failed to allocate memory for service node");
-		free(newNode);
-		return;
+
+	digital_input_subscriber_t *subscriber = digital_input_get_subscriber(user_data, true);
+	if (subscriber == NULL) {
+		LOG_ERR("No free digital input subscriber");
+		return STATUS_FAIL;
 	}
-	new_service_node->cb = callback;
-	new_service_node->user_data = user_data;
-	new_service_node->next = NULL;
-	// add the service node to the linked list
-	newNode->services = new_service_node;
-	// update its input state
-	newNode->state = digital_input_read(index);
-    // append the new node to the end of the list
-    utils_append_node((utils_node_t *)newNode, (utils_node_t *)headNodeSubscribedInputs);
-
-	// resume the task if it is suspended
-	k_thread_resume(digital_input_polling_task);
+	subscriber->notify = notify;
+	atomic_or(&subscriber->mask, BIT(index));
+
+	// wake the task to take the state of the input and recompute its timeout
+	digital_input_wake_up();
+	return STATUS_OK;
 }
 
 void digital_input_unsubscribe(void *user_data, uint8_t index)
@@ -265,88 +775,83 @@ void digital_input_unsubscribe(void *user_data, uint8_t index)
 		return;
 	}
 
-	// check if it is already subscribed
-	node_subscribed_inputs_t *current = headNodeSubscribedInputs;
-    node_subscribed_inputs_t *prev = NULL;
-	while (current != NULL) {
-		if (current->index == index) {
-            // remove service node from the linked list
-            service_node_t *current_service = current->services;
-            service_node_t *prev_service = NULL;
-            while (current_service != NULL) {
-                if (current_service->user_data == user_data) {
-                    // remove the service node
-                    if (prev_service == NULL) {
-                        current->services = current_service->next;
-                    } else {
-                        prev_service->next = current_service->next;
-                    }
-                    free(current_service);
-                    break;
-                }
-                prev_service = current_service;
-                current_service = current_service->next;
-            }
-
-            // check if there are no more services subscribed to this digital input
-            if (current->services == NULL) {
-                // remove the node from the linked list
-                if (prev == NULL) {
-                    headNodeSubscribedInputs = current->next;
-                } else {
-                    prev->next = current->next;
-                }
-                // free the node
-			    utils_free_node((utils_node_t *)current);
-            }
-			return;
-		}
-        prev = current;
-		current = current->next;
+	digital_input_subscriber_t *subscriber = digital_input_get_subscriber(user_data, false);
+	if (subscriber != NULL) {
+		atomic_and(&subscriber->mask, ~BIT(index));
 	}
 }
 
+// unsubscribe from all digital inputs and release the slot, e.g. when a connection is closed
 void digital_input_unsubscribe_all(void *user_data)
 {
-    node_subscribed_inputs_t *current = headNodeSubscribedInputs;
-    while (current != NULL) {
-        service_node_t *current_service = current->services;
-        while (current_service != NULL) {
-            if (current_service->user_data == user_data) {
-                digital_input_unsubscribe(user_data, current->index);
-                break;
-            }
-            current_service = current_service->next;
-        }
-        current = current->next;
-    }
+	digital_input_subscriber_t *subscriber = digital_input_get_subscriber(user_data, false);
+	if (subscriber != NULL) {
+		atomic_clear(&subscriber->mask);
+		atomic_ptr_clear(&subscriber->user_data);
+	}
 }
 
-// print current subscribed digital inputs
-// note: this function only prints the index of the subscribed digital inputs with a space as the
-// delimiter.
-void digital_input_print_subscribed_inputs(void *user_data, digital_input_callback_fn_t cb)
+// get the bit mask of the digital inputs subscribed by a client
+uint32_t digital_input_get_subscribed(void *user_data)
 {
-	node_subscribed_inputs_t *current = headNodeSubscribedInputs;
-restart:
-	while (current != NULL) {
-        // go through the linked list of services
-        // check if the user_data is equal to the service of the current node
-        service_node_t *current_service = current->services;
-        while (current_service != NULL) {
-            if (current_service->user_data == user_data) {
-                break;
-            }
-            if ((current_service = current_service->next) == NULL) {
-                current = current->next;
-                goto restart;
-            }
-        }
-        // print the index of the subscribed digital input
-        cb(user_data, "%d", current->index + 1);
-		current = current->next;
-		if (current != NULL) {
-            cb(user_data, " ");
-		}
+	digital_input_subscriber_t *subscriber = digital_input_get_subscriber(user_data, false);
+	return (subscriber != NULL) ? (uint32_t)atomic_get(&subscriber->mask) : 0;
+}
+
+/**
+ * @brief   select how the changed inputs of a client are queued
+ * @param   coalesced   true to queue all changes within a window as one event,
+ *                      false to queue one event per changed input
+ * @param   window      coalescing window in ms, 0 queues the changes of each scan at once
+ */
+io_status_t digital_input_set_coalescing(void *user_data, bool coalesced, uint16_t window)
+{
+	if (user_data == NULL) {
+		return STATUS_ERROR;
+	}
+
+	digital_input_subscriber_t *subscriber = digital_input_get_subscriber(user_data, true);
+	if (subscriber == NULL) {
+		LOG_ERR("No free digital input subscriber");
+		return STATUS_FAIL;
+	}
+	subscriber->window = window;
+	subscriber->coalesced = coalesced;
+	return STATUS_OK;
+}
+
+// get the coalescing window of a client, return false if one event is queued per input
+bool digital_input_get_coalescing(void *user_data, uint16_t *window)
+{
+	digital_input_subscriber_t *subscriber = digital_input_get_subscriber(user_data, false);
+	if (subscriber == NULL || !subscriber->coalesced) {
+		return false;
 	}
-}
\ No newline at end of file
+	*window = subscriber->window;
+	return true;
+}
+
+// take the next queued event of a client, called from the client's own thread
+bool digital_input_get_event(void *user_data, digital_input_event_t *event)
+{
+	digital_input_subscriber_t *subscriber = digital_input_get_subscriber(user_data, false);
+	if (subscriber == NULL) {
+		return false;
+	}
+
+	atomic_val_t tail = atomic_get(&subscriber->tail);
+	if (tail == atomic_get(&subscriber->head)) {
+		return false;
+	}
+	*event = subscriber->events[tail & (DIGITAL_INPUT_EVENT_MAX - 1)];
+	// release the slot after the event is copied
+	atomic_set(&subscriber->tail, tail + 1);
+	return true;
+}
+
+// get and reset the number of events of a client lost because its ring was full
+uint32_t digital_input_take_dropped(void *user_data)
+{
+	digital_input_subscriber_t *subscriber = digital_input_get_subscriber(user_data, false);
+	return (subscriber != NULL) ? (uint32_t)atomic_clear(&subscriber->dropped) : 0;
+}
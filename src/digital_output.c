@@ -5,10 +5,13 @@ LOG_MODULE_REGISTER(digital_output, LOG_LEVEL_DBG);
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/sys/util_macro.h>
+#include <zephyr/sys/math_extras.h>
 
 #include "stm32f7xx_remote_io.h"
 #include "digital_output.h"
 
+#define DIGITAL_OUTPUT_VERIFY_INTERVAL 1 // ms
+
 #define GET_GPIO_SPEC(id, _) \
     static const struct gpio_dt_spec digital_output_##id = \
         GPIO_DT_SPEC_GET(DT_NODELABEL(usr_out_##id), gpios)
@@ -18,9 +21,113 @@ LOG_MODULE_REGISTER(digital_output, LOG_LEVEL_DBG);
     case id: \
         return (struct gpio_dt_spec *)&digital_output_##id
 
+/* Type definition */
+// a GPIO port with at least one digital output
+typedef struct DigitalOutputPort
+{
+    const struct device *port;
+    gpio_port_pins_t active_low; // pins whose raw level is inverted, e.g. open-drain outputs driven low when active
+    uint32_t outputs; // bit mask of the outputs on the port
+} digital_output_port_t;
+
+// digital outputs whose pin number is their index plus the same offset on the same port,
+// their pins are set or cleared from the output bits with one mask and one shift
+typedef struct DigitalOutputRun
+{
+    uint32_t outputs; // bit mask of the outputs of the run
+    int8_t shift; // pin number minus output index
+    uint8_t port; // index in digitalOutputPorts
+} digital_output_run_t;
+
+// pulse generated on a digital output by its own timer
+typedef struct DigitalOutputPulse
+{
+    struct k_timer timer;
+    uint32_t on_time; // ms
+    uint32_t off_time; // ms
+    uint32_t count; // pulses left, 0 repeats until stopped
+    int64_t deadline; // uptime in ticks of the next edge
+    bool active; // state of the output in the current phase
+} digital_output_pulse_t;
+
+/* private functions */
+struct gpio_dt_spec *digital_output_get_gpio_spec(uint8_t index);
+static void digital_output_verify(struct k_timer *timer);
+static void digital_output_pulse_expiry(struct k_timer *timer);
+
 // listify the GPIO spec
 LISTIFY(DIGITAL_OUTPUT_MAX, GET_GPIO_SPEC, (;));
 
+// port and run tables used to write several outputs at once, see digital_output_write_masked()
+static digital_output_port_t digitalOutputPorts[DIGITAL_OUTPUT_MAX];
+static uint8_t digitalOutputPortCount = 0;
+static digital_output_run_t digitalOutputRuns[DIGITAL_OUTPUT_MAX];
+static uint8_t digitalOutputRunCount = 0;
+
+// state of all outputs as last written, 1/active, 0/inactive
+static atomic_t outputShadow = ATOMIC_INIT(0);
+// keeps the shadow in line with the ports while several outputs are written or verified
+static struct k_spinlock outputLock;
+
+// verify mode, the shadow is compared against the ports periodically
+static atomic_t verifyEnabled = ATOMIC_INIT(0);
+static atomic_t verifyMismatches = ATOMIC_INIT(0); // number of scans with a mismatch
+static atomic_t verifyOutputs = ATOMIC_INIT(0); // outputs that differed in the last mismatch
+
+K_TIMER_DEFINE(digital_output_verify_timer, digital_output_verify, NULL);
+
+// pulses of the digital outputs, one timer per output
+static digital_output_pulse_t digitalOutputPulses[DIGITAL_OUTPUT_MAX];
+static atomic_t pulseOutputs = ATOMIC_INIT(0); // outputs with a running pulse
+
+// group the digital outputs by port and into runs of the same pin offset
+static void digital_output_port_init(void)
+{
+    for (uint8_t i = 0; i < DIGITAL_OUTPUT_MAX; i++)
+    {
+        struct gpio_dt_spec *spec = digital_output_get_gpio_spec(i);
+        uint8_t port = 0;
+        uint8_t run = 0;
+        int8_t shift = (int8_t)spec->pin - (int8_t)i;
+
+        // find or add the port
+        while (port < digitalOutputPortCount && digitalOutputPorts[port].port != spec->port)
+        {
+            port++;
+        }
+        if (port == digitalOutputPortCount)
+        {
+            digitalOutputPorts[port].port = spec->port;
+            digitalOutputPorts[port].active_low = 0;
+            digitalOutputPorts[port].outputs = 0;
+            digitalOutputPortCount++;
+        }
+        digitalOutputPorts[port].outputs |= BIT(i);
+        if (spec->dt_flags & GPIO_ACTIVE_LOW)
+        {
+            digitalOutputPorts[port].active_low |= BIT(spec->pin);
+        }
+
+        // find or add the run
+        while (run < digitalOutputRunCount &&
+               (digitalOutputRuns[run].port != port || digitalOutputRuns[run].shift != shift))
+        {
+            run++;
+        }
+        if (run == digitalOutputRunCount)
+        {
+            digitalOutputRuns[run].port = port;
+            digitalOutputRuns[run].shift = shift;
+            digitalOutputRuns[run].outputs = 0;
+            digitalOutputRunCount++;
+        }
+        digitalOutputRuns[run].outputs |= BIT(i);
+
+        k_timer_init(&digitalOutputPulses[i].timer, digital_output_pulse_expiry, NULL);
+    }
+    LOG_INF("Digital outputs: %d ports, %d runs", digitalOutputPortCount, digitalOutputRunCount);
+}
+
 void digital_output_init()
 {
     // check if GPIO is ready
@@ -36,6 +143,16 @@ void digital_output_init()
         LOG_ERR("Failed to configure digital output GPIO");
         return;
     }
+
+    digital_output_port_init();
+
+    // the shadow starts from the state set by the configuration
+    uint32_t data = 0;
+    if (digital_output_read_hardware(&data) < 0)
+    {
+        LOG_ERR("Failed to read digital outputs");
+    }
+    atomic_set(&outputShadow, (atomic_val_t)data);
 }
 
 // get gpio spec
@@ -52,35 +169,99 @@ struct gpio_dt_spec *digital_output_get_gpio_spec(uint8_t index)
     }
 }
 
-// read data from digital output and update the state in the digital output instance
+// read the state of a digital output as last written
 int digital_output_read(uint8_t index)
 {
-    int ret = gpio_pin_get_dt(digital_output_get_gpio_spec(index));
-    if (ret < 0)
+    if (index >= DIGITAL_OUTPUT_MAX)
     {
-        LOG_ERR("Failed to read digital output %d", index);
-        return ret;
+        LOG_ERR("Invalid digital output index %d", index);
+        return -1;
     }
 
-    return ret; // 1/active, 0/inactive
+    return ((uint32_t)atomic_get(&outputShadow) >> index) & 0x01; // 1/active, 0/inactive
 }
 
-// read all digital outputs
+// read the state of all digital outputs as last written from the shadow, the ports are not accessed
 uint32_t digital_output_read_all()
 {
-    uint32_t data = 0;
-    int ret = 0;
-    for (uint8_t i = 0; i < DIGITAL_OUTPUT_MAX; i++)
+    return (uint32_t)atomic_get(&outputShadow);
+}
+
+/**
+ * @brief   read the state of all digital outputs from the ports
+ * @note    each port is read once
+ * @param   data  state of all digital outputs, 1/active, 0/inactive
+ * @return  0 on success, a negative errno code otherwise
+ */
+int digital_output_read_hardware(uint32_t *data)
+{
+    gpio_port_value_t values[DIGITAL_OUTPUT_MAX];
+
+    for (uint8_t i = 0; i < digitalOutputPortCount; i++)
     {
-        ret = digital_output_read(i);
+        int ret = gpio_port_get_raw(digitalOutputPorts[i].port, &values[i]);
         if (ret < 0)
         {
-            LOG_ERR("Failed to read digital output %d", i);
-            return (uint32_t)ret;
+            return ret;
         }
-        data |= (ret << (i));
+        values[i] ^= digitalOutputPorts[i].active_low;
+    }
+
+    *data = 0;
+    for (uint8_t i = 0; i < digitalOutputRunCount; i++)
+    {
+        const digital_output_run_t *run = &digitalOutputRuns[i];
+        uint32_t pins = values[run->port];
+        *data |= ((run->shift >= 0) ? (pins >> run->shift) : (pins << -run->shift)) & run->outputs;
+    }
+    return 0;
+}
+
+// compare the shadow against the ports, called by the timer in interrupt context
+static void digital_output_verify(struct k_timer *timer)
+{
+    uint32_t data = 0;
+
+    k_spinlock_key_t key = k_spin_lock(&outputLock);
+    int ret = digital_output_read_hardware(&data);
+    uint32_t shadow = (uint32_t)atomic_get(&outputShadow);
+    k_spin_unlock(&outputLock, key);
+
+    if (ret < 0 || data != shadow)
+    {
+        atomic_inc(&verifyMismatches);
+        atomic_set(&verifyOutputs, (atomic_val_t)(ret < 0 ? BIT_MASK(DIGITAL_OUTPUT_MAX) : data ^ shadow));
+    }
+}
+
+// enable or disable the verify mode, enabling it clears the mismatch count
+void digital_output_set_verify(bool enable)
+{
+    atomic_set(&verifyEnabled, enable);
+    if (enable)
+    {
+        atomic_clear(&verifyMismatches);
+        atomic_clear(&verifyOutputs);
+        k_timer_start(&digital_output_verify_timer, K_MSEC(DIGITAL_OUTPUT_VERIFY_INTERVAL),
+                      K_MSEC(DIGITAL_OUTPUT_VERIFY_INTERVAL));
+    }
+    else
+    {
+        k_timer_stop(&digital_output_verify_timer);
     }
-    return data;
+}
+
+/**
+ * @brief   get the result of the verify mode
+ * @param   mismatches  number of scans whose port state differed from the shadow
+ * @param   outputs     outputs that differed in the last mismatch
+ * @return  true if the verify mode is enabled
+ */
+bool digital_output_get_verify(uint32_t *mismatches, uint32_t *outputs)
+{
+    *mismatches = (uint32_t)atomic_get(&verifyMismatches);
+    *outputs = (uint32_t)atomic_get(&verifyOutputs);
+    return atomic_get(&verifyEnabled) != 0;
 }
 
 // write data to digital output
@@ -93,22 +274,177 @@ int digital_output_write(uint8_t index, bool state)
     }
 
     // write the state to the GPIO pin
-    return gpio_pin_set_dt(digital_output_get_gpio_spec(index), state);
+    return digital_output_write_masked(BIT(index), state ? BIT(index) : 0);
 }
 
-// write data to digital outputs
+// write data to digital outputs, the outputs of a port change at the same time
 int digital_output_write_multiple(uint32_t data, uint8_t start_index, uint8_t length)
 {
-    int ret = 0;
+    if (start_index >= DIGITAL_OUTPUT_MAX || length > DIGITAL_OUTPUT_MAX - start_index)
+    {
+        LOG_ERR("Invalid digital outputs %d ... %d", start_index, start_index + length - 1);
+        return -1;
+    }
 
-    for (uint8_t i = 0; i < length; i++)
+    return digital_output_write_masked(BIT_MASK(length) << start_index, data << start_index);
+}
+
+// set and clear the selected outputs of each port with one register write and update the shadow
+// note: this function may be called from interrupt context
+static int digital_output_write_ports(uint32_t mask, uint32_t data)
+{
+    gpio_port_pins_t set[DIGITAL_OUTPUT_MAX] = {0};
+    gpio_port_pins_t clear[DIGITAL_OUTPUT_MAX] = {0};
+
+    if (digitalOutputPortCount == 0)
+    {
+        LOG_ERR("Digital outputs are not initialized");
+        return -ENODEV;
+    }
+
+    // gather the active and inactive pins of each port
+    for (uint8_t i = 0; i < digitalOutputRunCount; i++)
     {
-        if ((ret = digital_output_write(start_index + i, (data >> i) & 0x01)) < 0)
+        const digital_output_run_t *run = &digitalOutputRuns[i];
+        uint32_t active = data & mask & run->outputs;
+        uint32_t inactive = ~data & mask & run->outputs;
+
+        set[run->port] |= (run->shift >= 0) ? (active << run->shift) : (active >> -run->shift);
+        clear[run->port] |= (run->shift >= 0) ? (inactive << run->shift) : (inactive >> -run->shift);
+    }
+
+    int ret = 0;
+    k_spinlock_key_t key = k_spin_lock(&outputLock);
+    for (uint8_t i = 0; i < digitalOutputPortCount; i++)
+    {
+        const digital_output_port_t *port = &digitalOutputPorts[i];
+        if ((set[i] | clear[i]) == 0)
         {
-            LOG_ERR("Failed to write digital output %d", start_index + i);
-            return ret;
+            continue;
+        }
+
+        // active low pins are cleared to become active
+        gpio_port_pins_t set_raw = (set[i] & ~port->active_low) | (clear[i] & port->active_low);
+        gpio_port_pins_t clear_raw = (clear[i] & ~port->active_low) | (set[i] & port->active_low);
+        ret = gpio_port_set_clr_bits_raw(port->port, set_raw, clear_raw);
+        if (ret < 0)
+        {
+            break;
         }
+        // the outputs of the ports written so far are in the shadow
+        uint32_t written = mask & port->outputs;
+        atomic_set(&outputShadow, (atomic_get(&outputShadow) & ~written) | (data & written));
     }
+    k_spin_unlock(&outputLock, key);
 
+    if (ret < 0)
+    {
+        LOG_ERR("Failed to write digital outputs");
+    }
     return ret;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief   write the bits of data selected by mask to the digital outputs, other outputs are left untouched
+ * @note    all selected outputs of a port are set and cleared with one register write,
+ *          so they change at the same time; pulses running on the selected outputs are stopped
+ * @param   mask  bit mask of the outputs to write
+ * @param   data  state of the outputs, 1/active, 0/inactive
+ * @return  0 on success, a negative errno code otherwise
+ */
+int digital_output_write_masked(uint32_t mask, uint32_t data)
+{
+    digital_output_pulse_stop(mask);
+    return digital_output_write_ports(mask, data);
+}
+
+// toggle a pulsing output at the end of its on or off time, called by its timer in interrupt context
+static void digital_output_pulse_expiry(struct k_timer *timer)
+{
+    digital_output_pulse_t *pulse = CONTAINER_OF(timer, digital_output_pulse_t, timer);
+    uint8_t index = (uint8_t)(pulse - digitalOutputPulses);
+
+    if (pulse->active)
+    {
+        digital_output_write_ports(BIT(index), 0);
+        pulse->active = false;
+        // the last pulse is done
+        if (pulse->count != 0 && --pulse->count == 0)
+        {
+            atomic_clear_bit(&pulseOutputs, index);
+            return;
+        }
+        pulse->deadline += k_ms_to_ticks_ceil64(pulse->off_time);
+    }
+    else
+    {
+        digital_output_write_ports(BIT(index), BIT(index));
+        pulse->active = true;
+        pulse->deadline += k_ms_to_ticks_ceil64(pulse->on_time);
+    }
+
+    // the edges are scheduled from the previous deadline, so the period does not drift
+    k_timer_start(timer, K_TIMEOUT_ABS_TICKS(pulse->deadline), K_NO_WAIT);
+}
+
+/**
+ * @brief   pulse a digital output, the edges are timed by a kernel timer per output without any thread
+ *          the output is active for on_time, then inactive for off_time, count times
+ * @param   index     index of the output
+ * @param   on_time   active time in ms
+ * @param   off_time  inactive time in ms between two pulses, ignored for a single pulse
+ * @param   count     number of pulses, 1 for a one-shot, 0 repeats until stopped
+ * @return  0 on success, a negative errno code otherwise
+ */
+int digital_output_pulse(uint8_t index, uint32_t on_time, uint32_t off_time, uint32_t count)
+{
+    if (index >= DIGITAL_OUTPUT_MAX || on_time == 0 || (count != 1 && off_time == 0))
+    {
+        LOG_ERR("Invalid pulse on digital output %d", index);
+        return -EINVAL;
+    }
+    if (digitalOutputPortCount == 0)
+    {
+        LOG_ERR("Digital outputs are not initialized");
+        return -ENODEV;
+    }
+
+    digital_output_pulse_t *pulse = &digitalOutputPulses[index];
+
+    k_timer_stop(&pulse->timer);
+    pulse->on_time = on_time;
+    pulse->off_time = off_time;
+    pulse->count = count;
+    pulse->active = true;
+    pulse->deadline = k_uptime_ticks() + k_ms_to_ticks_ceil64(on_time);
+    atomic_set_bit(&pulseOutputs, index);
+
+    int ret = digital_output_write_ports(BIT(index), BIT(index));
+    if (ret < 0)
+    {
+        atomic_clear_bit(&pulseOutputs, index);
+        return ret;
+    }
+    k_timer_start(&pulse->timer, K_TIMEOUT_ABS_TICKS(pulse->deadline), K_NO_WAIT);
+    return 0;
+}
+
+// stop the pulses of the selected outputs, the outputs keep their current state
+void digital_output_pulse_stop(uint32_t mask)
+{
+    uint32_t stopped = mask & (uint32_t)atomic_get(&pulseOutputs);
+
+    while (stopped != 0)
+    {
+        uint8_t index = u32_count_trailing_zeros(stopped);
+        k_timer_stop(&digitalOutputPulses[index].timer);
+        atomic_clear_bit(&pulseOutputs, index);
+        stopped &= stopped - 1;
+    }
+}
+
+// get the bit mask of the outputs with a running pulse
+uint32_t digital_output_get_pulsing(void)
+{
+    return (uint32_t)atomic_get(&pulseOutputs);
+}
@@ -0,0 +1,239 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(digital_reflex, LOG_LEVEL_DBG);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "stm32f7xx_remote_io.h"
+#include "digital_reflex.h"
+#include "digital_input.h"
+#include "digital_output.h"
+#include "flash.h"
+
+// the conditions and actions are bit masks and indexes of 16 inputs and outputs
+BUILD_ASSERT(DIGITAL_INPUT_MAX <= 16 && DIGITAL_OUTPUT_MAX <= 16);
+
+/* type definition */
+// rule table as stored in flash
+typedef struct DigitalReflexTable {
+	uint8_t version; // DIGITAL_REFLEX_VERSION
+	uint8_t enabled; // the rules are evaluated
+	uint8_t count; // number of rules
+	digital_reflex_rule_t rules[DIGITAL_REFLEX_RULES_MAX];
+} digital_reflex_table_t;
+
+// state of a rule, used by the task evaluating the rules under the lock
+typedef struct DigitalReflexState {
+	bool valid; // the condition has been evaluated since the rule was changed or enabled
+	bool met; // the condition was met in the last scan
+	bool pending; // the action for the current condition has not been taken yet
+	uint32_t since; // uptime in ms when the condition changed
+} digital_reflex_state_t;
+
+/* variables */
+static digital_reflex_table_t reflexTable;
+static digital_reflex_state_t reflexState[DIGITAL_REFLEX_RULES_MAX];
+// inputs of the conditions of the enabled rules, polled by the digital input task
+static atomic_t reflexInputs = ATOMIC_INIT(0);
+// protects the table, taken by the API and the digital input task or the scan engine
+K_MUTEX_DEFINE(reflexLock);
+
+// recompute the inputs to poll and restart the evaluation of all rules, called with the lock held
+static void digital_reflex_update(void)
+{
+	uint32_t inputs = 0;
+
+	if (reflexTable.enabled) {
+		for (uint8_t i = 0; i < reflexTable.count; i++) {
+			inputs |= reflexTable.rules[i].input_mask;
+		}
+	}
+	for (uint8_t i = 0; i < DIGITAL_REFLEX_RULES_MAX; i++) {
+		reflexState[i].valid = false;
+	}
+	atomic_set(&reflexInputs, (atomic_val_t)inputs);
+
+	// let the digital input task poll the inputs of the rules
+	digital_input_wake_up();
+}
+
+// load the rule table from flash, an empty and disabled table is used if there is none
+io_status_t digital_reflex_init(void)
+{
+	k_mutex_lock(&reflexLock, K_FOREVER);
+	if (flash_read_data_with_checksum(FLASH_SECTOR_REFLEX, (uint8_t *)&reflexTable, sizeof(reflexTable)) != STATUS_OK ||
+	    reflexTable.version != DIGITAL_REFLEX_VERSION || reflexTable.count > DIGITAL_REFLEX_RULES_MAX) {
+		LOG_INF("No reflex rules in flash");
+		memset(&reflexTable, 0, sizeof(reflexTable));
+		reflexTable.version = DIGITAL_REFLEX_VERSION;
+	}
+	digital_reflex_update();
+	k_mutex_unlock(&reflexLock);
+
+	LOG_INF("Reflex rules: %d, %s", reflexTable.count, reflexTable.enabled ? "enabled" : "disabled");
+	return STATUS_OK;
+}
+
+/**
+ * @brief   replace a rule or append it to the table
+ * @param   index  index of the rule, the number of rules to append it
+ * @param   rule   the rule
+ * @return  STATUS_ERROR if the index or the rule is invalid
+ */
+io_status_t digital_reflex_set_rule(uint8_t index, const digital_reflex_rule_t *rule)
+{
+	if (index >= DIGITAL_REFLEX_RULES_MAX || rule->output >= DIGITAL_OUTPUT_MAX ||
+	    rule->action > DIGITAL_REFLEX_ACTION_FOLLOW_INVERTED ||
+	    (rule->input_mask & ~BIT_MASK(DIGITAL_INPUT_MAX)) || (rule->input_value & ~rule->input_mask)) {
+		return STATUS_ERROR;
+	}
+
+	io_status_t status = STATUS_ERROR;
+	k_mutex_lock(&reflexLock, K_FOREVER);
+	if (index <= reflexTable.count) {
+		reflexTable.rules[index] = *rule;
+		if (index == reflexTable.count) {
+			reflexTable.count++;
+		}
+		digital_reflex_update();
+		status = STATUS_OK;
+	}
+	k_mutex_unlock(&reflexLock);
+
+	return status;
+}
+
+io_status_t digital_reflex_get_rule(uint8_t index, digital_reflex_rule_t *rule)
+{
+	io_status_t status = STATUS_ERROR;
+
+	k_mutex_lock(&reflexLock, K_FOREVER);
+	if (index < reflexTable.count) {
+		*rule = reflexTable.rules[index];
+		status = STATUS_OK;
+	}
+	k_mutex_unlock(&reflexLock);
+
+	return status;
+}
+
+// delete a rule, the following rules move up by one
+io_status_t digital_reflex_delete_rule(uint8_t index)
+{
+	io_status_t status = STATUS_ERROR;
+
+	k_mutex_lock(&reflexLock, K_FOREVER);
+	if (index < reflexTable.count) {
+		reflexTable.count--;
+		memmove(&reflexTable.rules[index], &reflexTable.rules[index + 1],
+			(reflexTable.count - index) * sizeof(digital_reflex_rule_t));
+		digital_reflex_update();
+		status = STATUS_OK;
+	}
+	k_mutex_unlock(&reflexLock);
+
+	return status;
+}
+
+void digital_reflex_delete_all(void)
+{
+	k_mutex_lock(&reflexLock, K_FOREVER);
+	reflexTable.count = 0;
+	digital_reflex_update();
+	k_mutex_unlock(&reflexLock);
+}
+
+uint8_t digital_reflex_count(void)
+{
+	return reflexTable.count;
+}
+
+// enable or disable the evaluation of all rules, the outputs keep their state when disabled
+void digital_reflex_enable(bool enable)
+{
+	k_mutex_lock(&reflexLock, K_FOREVER);
+	reflexTable.enabled = enable;
+	digital_reflex_update();
+	k_mutex_unlock(&reflexLock);
+}
+
+bool digital_reflex_is_enabled(void)
+{
+	return reflexTable.enabled;
+}
+
+// save the rule table and its enable flag in flash, the rules are evaluated after a restart as saved
+io_status_t digital_reflex_save(void)
+{
+	k_mutex_lock(&reflexLock, K_FOREVER);
+	io_status_t status = flash_write_data_with_checksum(FLASH_SECTOR_REFLEX, (uint8_t *)&reflexTable,
+							     sizeof(reflexTable));
+	k_mutex_unlock(&reflexLock);
+
+	return status;
+}
+
+// get the bit mask of the inputs the enabled rules depend on
+uint32_t digital_reflex_inputs(void)
+{
+	return (uint32_t)atomic_get(&reflexInputs);
+}
+
+/**
+ * @brief   evaluate all rules against a snapshot of the inputs and write the outputs of the due actions at once
+ *          called by the digital input task right after each scan, or by the scan engine in each cycle while it runs
+ * @param   state  debounced state of all inputs, or their sampled state in a cycle of the scan engine
+ * @param   now    uptime in ms of the scan
+ */
+void digital_reflex_evaluate(uint32_t state, uint32_t now)
+{
+	uint32_t mask = 0;
+	uint32_t data = 0;
+
+	if (digital_reflex_inputs() == 0) {
+		return;
+	}
+
+	k_mutex_lock(&reflexLock, K_FOREVER);
+	for (uint8_t i = 0; i < reflexTable.count && reflexTable.enabled; i++) {
+		const digital_reflex_rule_t *rule = &reflexTable.rules[i];
+		digital_reflex_state_t *rule_state = &reflexState[i];
+		bool met = (state & rule->input_mask) == rule->input_value;
+
+		if (!rule_state->valid || met != rule_state->met) {
+			rule_state->valid = true;
+			rule_state->met = met;
+			rule_state->pending = true;
+			rule_state->since = now;
+		}
+		if (!rule_state->pending || (now - rule_state->since) < rule->delay) {
+			continue;
+		}
+		rule_state->pending = false;
+
+		// later rules on the same output win
+		bool active;
+		switch (rule->action) {
+		case DIGITAL_REFLEX_ACTION_SET:
+		case DIGITAL_REFLEX_ACTION_CLEAR:
+			if (!met) {
+				continue;
+			}
+			active = (rule->action == DIGITAL_REFLEX_ACTION_SET);
+			break;
+		case DIGITAL_REFLEX_ACTION_FOLLOW:
+			active = met;
+			break;
+		default:
+			active = !met;
+			break;
+		}
+		mask |= BIT(rule->output);
+		WRITE_BIT(data, rule->output, active);
+	}
+	k_mutex_unlock(&reflexLock);
+
+	if (mask != 0 && digital_output_write_masked(mask, data) < 0) {
+		LOG_ERR("Failed to write the outputs of the reflex rules");
+	}
+}
@@ -0,0 +1,290 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(digital_sequencer, LOG_LEVEL_DBG);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "stm32f7xx_remote_io.h"
+#include "digital_sequencer.h"
+#include "digital_output.h"
+
+/* type definition */
+typedef struct DigitalSequencerTable {
+	digital_sequencer_step_t steps[DIGITAL_SEQUENCER_STEPS_MAX];
+	uint16_t count; // number of steps
+	uint64_t duration; // sum of the delta times in ms
+} digital_sequencer_table_t;
+
+/* private functions */
+static void digital_sequencer_expiry(struct k_timer *timer);
+
+/* variables */
+// the client owning the sequencer, NULL if the sequencer is free
+static atomic_ptr_t sequencerOwner = ATOMIC_PTR_INIT(NULL);
+static digital_input_notify_fn_t sequencerNotify;
+static atomic_t sequencerEvents = ATOMIC_INIT(0); // DIGITAL_SEQUENCER_EVENT_* not taken by the owner yet
+
+// double-buffered tables, one is played by the timer while the other one is loaded by the owner
+static digital_sequencer_table_t sequencerTables[2];
+// playback state, shared by the owner's thread and the timer under the lock
+static struct k_spinlock sequencerLock;
+static uint8_t playTable = 0; // index of the played table, the other one is loaded
+static uint16_t playStep = 0; // index of the next step
+static int64_t playDeadline; // uptime in ticks of the next step
+static uint32_t playPasses = 0; // tables played to their end since the start
+static uint8_t playMode = DIGITAL_SEQUENCER_MODE_ONCE;
+static bool playing = false;
+static bool queued = false; // the loaded table follows the played table
+static uint8_t queuedMode = DIGITAL_SEQUENCER_MODE_ONCE;
+
+K_TIMER_DEFINE(digital_sequencer_timer, digital_sequencer_expiry, NULL);
+
+// claim the sequencer for a client, or check that the client owns it
+static bool digital_sequencer_claim(void *user_data)
+{
+	return user_data != NULL && (atomic_ptr_cas(&sequencerOwner, NULL, user_data) ||
+				     atomic_ptr_get(&sequencerOwner) == user_data);
+}
+
+// report events to the owner
+static void digital_sequencer_notify(uint32_t events)
+{
+	if (events == 0) {
+		return;
+	}
+
+	atomic_or(&sequencerEvents, (atomic_val_t)events);
+	if (sequencerNotify != NULL) {
+		sequencerNotify(atomic_ptr_get(&sequencerOwner));
+	}
+}
+
+// make the loaded table the played one, the previous table is emptied to load the next one
+static void digital_sequencer_swap(uint8_t mode)
+{
+	playTable ^= 1;
+	playStep = 0;
+	playMode = mode;
+	queued = false;
+	sequencerTables[playTable ^ 1].count = 0;
+	sequencerTables[playTable ^ 1].duration = 0;
+}
+
+/**
+ * @brief   apply the due steps and schedule the next one, called with the lock held
+ *          steps without a delta time are applied together with the previous step
+ * @return  events to report to the owner
+ */
+static uint32_t digital_sequencer_run(void)
+{
+	uint32_t events = 0;
+
+	for (;;) {
+		const digital_sequencer_step_t *step = &sequencerTables[playTable].steps[playStep];
+		digital_output_write_masked(step->set_mask | step->clear_mask, step->set_mask);
+
+		if (++playStep == sequencerTables[playTable].count) {
+			playPasses++;
+			if (queued) {
+				digital_sequencer_swap(queuedMode);
+				events |= DIGITAL_SEQUENCER_EVENT_DONE;
+			} else if (playMode == DIGITAL_SEQUENCER_MODE_LOOP) {
+				playStep = 0;
+			} else {
+				if (playMode == DIGITAL_SEQUENCER_MODE_STREAM) {
+					events |= DIGITAL_SEQUENCER_EVENT_UNDERRUN;
+				}
+				playing = false;
+				return events | DIGITAL_SEQUENCER_EVENT_DONE;
+			}
+		}
+
+		uint32_t delta_time = sequencerTables[playTable].steps[playStep].delta_time;
+		if (delta_time != 0) {
+			// the steps are scheduled from the previous deadline, so the timing does not drift
+			playDeadline += k_ms_to_ticks_ceil64(delta_time);
+			k_timer_start(&digital_sequencer_timer, K_TIMEOUT_ABS_TICKS(playDeadline), K_NO_WAIT);
+			return events;
+		}
+	}
+}
+
+// play the next steps, called by the timer in interrupt context
+static void digital_sequencer_expiry(struct k_timer *timer)
+{
+	k_spinlock_key_t key = k_spin_lock(&sequencerLock);
+	uint32_t events = playing ? digital_sequencer_run() : 0;
+	k_spin_unlock(&sequencerLock, key);
+
+	digital_sequencer_notify(events);
+}
+
+/**
+ * @brief   append steps to the loaded table
+ * @param   user_data  the client, e.g. a connection, the first client loading a table owns the sequencer
+ * @param   steps      steps to append
+ * @param   count      number of steps
+ * @return  STATUS_ERROR if another client owns the sequencer, the loaded table is queued,
+ *          the table is full or a step selects an output that does not exist
+ */
+io_status_t digital_sequencer_load(void *user_data, const digital_sequencer_step_t *steps, uint16_t count)
+{
+	if (!digital_sequencer_claim(user_data)) {
+		return STATUS_ERROR;
+	}
+	for (uint16_t i = 0; i < count; i++) {
+		if ((steps[i].set_mask | steps[i].clear_mask) & ~BIT_MASK(DIGITAL_OUTPUT_MAX)) {
+			return STATUS_ERROR;
+		}
+	}
+
+	io_status_t status = STATUS_ERROR;
+	k_spinlock_key_t key = k_spin_lock(&sequencerLock);
+	digital_sequencer_table_t *table = &sequencerTables[playTable ^ 1];
+	if (!queued && count <= DIGITAL_SEQUENCER_STEPS_MAX - table->count) {
+		for (uint16_t i = 0; i < count; i++) {
+			table->steps[table->count++] = steps[i];
+			table->duration += steps[i].delta_time;
+		}
+		status = STATUS_OK;
+	}
+	k_spin_unlock(&sequencerLock, key);
+
+	return status;
+}
+
+// empty the loaded table, unless it is queued
+io_status_t digital_sequencer_clear(void *user_data)
+{
+	if (!digital_sequencer_claim(user_data)) {
+		return STATUS_ERROR;
+	}
+
+	io_status_t status = STATUS_ERROR;
+	k_spinlock_key_t key = k_spin_lock(&sequencerLock);
+	if (!queued) {
+		sequencerTables[playTable ^ 1].count = 0;
+		sequencerTables[playTable ^ 1].duration = 0;
+		status = STATUS_OK;
+	}
+	k_spin_unlock(&sequencerLock, key);
+
+	return status;
+}
+
+/**
+ * @brief   play the loaded table
+ *          if a table is playing, the loaded table is queued and takes over at the end of the playing table;
+ *          if nothing is playing and no table is loaded, the last table is played again
+ * @param   user_data  the client owning the sequencer
+ * @param   notify     called when events are reported, may be called from interrupt context
+ * @param   mode       DIGITAL_SEQUENCER_MODE_*
+ * @return  STATUS_ERROR if another client owns the sequencer, a table is already queued,
+ *          there is no table to play or a looped table takes no time
+ */
+io_status_t digital_sequencer_start(void *user_data, digital_input_notify_fn_t notify, uint8_t mode)
+{
+	if (mode > DIGITAL_SEQUENCER_MODE_STREAM || !digital_sequencer_claim(user_data)) {
+		return STATUS_ERROR;
+	}
+
+	uint32_t events = 0;
+	io_status_t status = STATUS_ERROR;
+	k_spinlock_key_t key = k_spin_lock(&sequencerLock);
+	const digital_sequencer_table_t *loaded = &sequencerTables[playTable ^ 1];
+
+	if (playing) {
+		// double-buffered, the loaded table follows the playing one
+		if (!queued && loaded->count != 0 && (mode != DIGITAL_SEQUENCER_MODE_LOOP || loaded->duration != 0)) {
+			queued = true;
+			queuedMode = mode;
+			status = STATUS_OK;
+		}
+	} else {
+		if (loaded->count != 0) {
+			digital_sequencer_swap(mode);
+		}
+		const digital_sequencer_table_t *table = &sequencerTables[playTable];
+		if (table->count != 0 && (mode != DIGITAL_SEQUENCER_MODE_LOOP || table->duration != 0)) {
+			sequencerNotify = notify;
+			atomic_clear(&sequencerEvents);
+			playStep = 0;
+			playMode = mode;
+			playPasses = 0;
+			playing = true;
+			playDeadline = k_uptime_ticks();
+			if (table->steps[0].delta_time == 0) {
+				events = digital_sequencer_run();
+			} else {
+				playDeadline += k_ms_to_ticks_ceil64(table->steps[0].delta_time);
+				k_timer_start(&digital_sequencer_timer, K_TIMEOUT_ABS_TICKS(playDeadline), K_NO_WAIT);
+			}
+			status = STATUS_OK;
+		}
+	}
+	k_spin_unlock(&sequencerLock, key);
+
+	digital_sequencer_notify(events);
+	return status;
+}
+
+// stop the playback, the outputs keep their state and a queued table is loaded again
+void digital_sequencer_stop(void *user_data)
+{
+	if (user_data == NULL || atomic_ptr_get(&sequencerOwner) != user_data) {
+		return;
+	}
+
+	k_timer_stop(&digital_sequencer_timer);
+	k_spinlock_key_t key = k_spin_lock(&sequencerLock);
+	playing = false;
+	queued = false;
+	k_spin_unlock(&sequencerLock, key);
+}
+
+// stop the playback and free the sequencer for other clients, e.g. when the connection is closed
+void digital_sequencer_release(void *user_data)
+{
+	if (user_data == NULL || atomic_ptr_get(&sequencerOwner) != user_data) {
+		return;
+	}
+
+	digital_sequencer_stop(user_data);
+	k_spinlock_key_t key = k_spin_lock(&sequencerLock);
+	sequencerTables[0].count = 0;
+	sequencerTables[1].count = 0;
+	sequencerTables[0].duration = 0;
+	sequencerTables[1].duration = 0;
+	sequencerNotify = NULL;
+	k_spin_unlock(&sequencerLock, key);
+	atomic_clear(&sequencerEvents);
+	atomic_ptr_clear(&sequencerOwner);
+}
+
+// check if a client owns the sequencer
+bool digital_sequencer_is_owner(void *user_data)
+{
+	return user_data != NULL && atomic_ptr_get(&sequencerOwner) == user_data;
+}
+
+// take the events reported since the last call, called from the owner's thread
+uint32_t digital_sequencer_take_events(void *user_data)
+{
+	if (!digital_sequencer_is_owner(user_data)) {
+		return 0;
+	}
+
+	return (uint32_t)atomic_clear(&sequencerEvents);
+}
+
+void digital_sequencer_get_status(digital_sequencer_status_t *status)
+{
+	k_spinlock_key_t key = k_spin_lock(&sequencerLock);
+	status->playing = playing;
+	status->mode = playMode;
+	status->step = playStep;
+	status->passes = playPasses;
+	status->loaded = sequencerTables[playTable ^ 1].count;
+	status->queued = queued;
+	k_spin_unlock(&sequencerLock, key);
+}
@@ -21,15 +21,20 @@ LOG_MODULE_REGISTER(ethernet_if, LOG_LEVEL_INF);
 #include "settings.h"
 #include "ethernet_if.h"
 #include "digital_input.h"
+#include "digital_capture.h"
+#include "digital_sequencer.h"
 
 // extern settings_t settings;
 
 #define PRESS_MORE_THAN_100MS 50 // 5s
 #define DEFAULT_PORT 8500
-#define MAX_RX_BUFFER_SIZE 128
+#define RX_RING_BUFFER_SIZE CONFIG_REMOTEIO_RX_BUFFER_SIZE
 #define MAX_TX_BUFFER_SIZE 128
+#define TX_ACCUMULATION_BUFFER_SIZE CONFIG_REMOTEIO_TX_BUFFER_SIZE
 #define POLLABLE_SOCKETS 2 // only one socket service
 
+BUILD_ASSERT(IS_POWER_OF_TWO(RX_RING_BUFFER_SIZE), "CONFIG_REMOTEIO_RX_BUFFER_SIZE must be a power of two");
+
 #if defined(CONFIG_NET_MAX_CONTEXTS)
 /* POLLABLE_SOCKETS must be less than CONFIG_NET_MAX_CONTEXTS */
 _Static_assert(POLLABLE_SOCKETS < CONFIG_NET_MAX_CONTEXTS,
@@ -37,15 +42,19 @@ _Static_assert(POLLABLE_SOCKETS < CONFIG_NET_MAX_CONTEXTS,
 #endif
 
 /* Local function prototypes */
-static void receive_data(struct net_socket_service_event *pev, char *buf, size_t buf_len);
+static void receive_data(struct net_socket_service_event *pev);
+static void pause_receiving(ethernet_if_socket_service_t *service);
+static void resume_receiving(ethernet_if_socket_service_t *service);
 static void tcp_service_handler(struct net_socket_service_event *pev);
 static int create_socket_service_thread(ethernet_if_socket_service_t *service);
 static int close_socket_service(ethernet_if_socket_service_t *service);
 static ethernet_if_socket_service_t *register_client_at_socket_service(int client);
 static int unregister_client_at_socket_service(int client);
 static int unregister_all_clients_at_socket_service(void);
+int ethernet_if_send_raw_bytes(ethernet_if_socket_service_t *service, const uint8_t *buf, size_t len);
 void ethernet_if_respond_handler(ethernet_if_socket_service_t *service, const char *format, ...);
 void ethernet_if_respond_raw_bytes_handler(ethernet_if_socket_service_t *service, const uint8_t *buf, size_t len);
+void ethernet_if_flush(ethernet_if_socket_service_t *service);
 
 // declare events
 K_EVENT_DEFINE(ethernet_if_events); // used to notify clients
@@ -91,9 +100,7 @@ struct in_addr gateway, netmask;
 
 static void tcp_service_handler(struct net_socket_service_event *pev)
 {
-    static char buf[MAX_RX_BUFFER_SIZE];
-
-    receive_data(pev, buf, sizeof(buf));
+    receive_data(pev);
 }
 
 #define _SERV_DESC_CASE_RETURN(ID, _) \
@@ -125,16 +132,79 @@ static ethernet_if_socket_service_t *get_eth_socket_service_via_client(int clien
     return NULL;
 }
 
-static void receive_data(struct net_socket_service_event *pev,
-            char *buf, size_t buf_len)
+/**
+ * @brief   Stop polling a client whose rx buffer is full
+ *          the flag is set before the free space is checked again, so either this function
+ *          sees the space freed by the api task meanwhile, or the api task sees the flag
+ * @param   service  pointer to the socket service
+ */
+static void pause_receiving(ethernet_if_socket_service_t *service)
+{
+    uint8_t *buf;
+
+    k_mutex_lock(&lock, K_FOREVER);
+    atomic_set(&service->rx_paused, 1);
+    if (utils_ring_write_span(service->service_context.rx_buffer, &buf) == 0) {
+        service->poll_fds.events = 0;
+        net_socket_service_register(service->service, &service->poll_fds, 1, NULL);
+    } else {
+        atomic_set(&service->rx_paused, 0);
+    }
+    k_mutex_unlock(&lock);
+}
+
+/**
+ * @brief   Poll a paused client again, called by the api task after it consumed rx data
+ * @param   service  pointer to the socket service
+ */
+static void resume_receiving(ethernet_if_socket_service_t *service)
+{
+    uint8_t *buf;
+
+    if (!atomic_get(&service->rx_paused)) {
+        return;
+    }
+
+    k_mutex_lock(&lock, K_FOREVER);
+    if (atomic_get(&service->rx_paused) && service->poll_fds.fd != -1 &&
+        utils_ring_write_span(service->service_context.rx_buffer, &buf) != 0) {
+        atomic_set(&service->rx_paused, 0);
+        service->poll_fds.events = POLLIN;
+        int ret = net_socket_service_register(service->service, &service->poll_fds, 1, NULL);
+        if (ret < 0) {
+            LOG_ERR("Failed to resume socket service: %d", ret);
+        }
+    }
+    k_mutex_unlock(&lock);
+}
+
+static void receive_data(struct net_socket_service_event *pev)
 {
     struct zsock_pollfd *pfd = &pev->event;
     int client = pfd->fd;
     struct sockaddr_in addr;
     socklen_t addr_len = sizeof(addr);
     int rev_len;
+    uint8_t *buf;
+    size_t buf_len = 0;
     // get the socket service
     ethernet_if_socket_service_t *service = get_eth_socket_service_via_client(client);
+    if (service != NULL) {
+        // receive directly into the free space of the rx ring buffer
+        buf_len = utils_ring_write_span(service->service_context.rx_buffer, &buf);
+        if (buf_len == 0) {
+            // the api task has not drained the ring buffer yet, leave the data in the socket
+            // and stop polling it until the api task has freed some space
+            pause_receiving(service);
+            k_event_post(&apiNewDataEvent, service->service_context.event);
+            return;
+        }
+    } else {
+        // no service to deliver to, read into a scratch buffer to detect the end of the connection
+        static uint8_t scratch[64];
+        buf = scratch;
+        buf_len = sizeof(scratch);
+    }
 
     rev_len = zsock_recvfrom(client, buf, buf_len, 0,
             (struct sockaddr *)&addr, &addr_len);
@@ -145,14 +215,14 @@ static void receive_data(struct net_socket_service_event *pev,
         } else {
             LOG_ERR("Receive error: %d", -errno);
         }
+        // stop the socket service thread before its buffers are released
+        close_socket_service(service);
+
         // unregister the socket service
         int ret = unregister_client_at_socket_service(client);
         if (ret < 0) {
             LOG_ERR("Failed to unregister socket service: %d", ret);
         }
-
-        // destroy the socket service thread
-        close_socket_service(service);
         // close the socket
         zsock_close(client);
         LOG_INF("Connection to %s closed", inet_ntoa(addr.sin_addr));
@@ -162,8 +232,8 @@ static void receive_data(struct net_socket_service_event *pev,
             LOG_ERR("Failed to get socket service");
             return;
         }
-        // append the received data to the rx buffer
-        utils_append_to_buffer(service->service_context.rx_buffer, buf, rev_len);
+        // publish the received data to the api task
+        utils_ring_commit(service->service_context.rx_buffer, rev_len);
         // send event to notify the API task to process the data
         k_event_post(&apiNewDataEvent, service->service_context.event);
     }
@@ -326,16 +396,32 @@ int tcp_server_init(void)
         }
         service->poll_fds.fd = -1; // initially invalid
         service->service = get_net_socket_service(i);
-        service->service_context.rx_buffer = malloc(sizeof(utils_ring_buffer_t));
+        service->service_context.rx_buffer = malloc(sizeof(utils_ring_t));
         if (service->service_context.rx_buffer == NULL) {
             LOG_ERR("Failed to allocate memory for rx buffer");
             free(service);
             return -ENOMEM;
         }
         service->service_context.rx_buffer->buffer = NULL;
+        // allocate the tx buffer, it is kept for the lifetime of the service
+        service->service_context.tx_buffer = malloc(sizeof(api_tx_buffer_t));
+        if (service->service_context.tx_buffer == NULL) {
+            LOG_ERR("Failed to allocate memory for tx buffer");
+            return -ENOMEM;
+        }
+        service->service_context.tx_buffer->buffer = malloc(TX_ACCUMULATION_BUFFER_SIZE);
+        if (service->service_context.tx_buffer->buffer == NULL) {
+            LOG_ERR("Failed to allocate memory for tx buffer");
+            return -ENOMEM;
+        }
+        service->service_context.tx_buffer->size = TX_ACCUMULATION_BUFFER_SIZE;
+        service->service_context.tx_buffer->length = 0;
+        k_mutex_init(&service->service_context.tx_buffer->lock);
         service->service_context.event =(1 << i);
         service->service_context.response_cb = (api_response_callback_t)&ethernet_if_respond_handler;
         service->service_context.response_cb_bytes = (api_response_callback_t)&ethernet_if_respond_raw_bytes_handler;
+        service->service_context.flush_cb = (api_flush_callback_t)&ethernet_if_flush;
+        service->service_context.rx_resume_cb = (api_flush_callback_t)&resume_receiving;
         service->service_context.user_data = service;
         service->stack = socket_service_stack_pool[i];
         // add the service to the table
@@ -447,11 +533,11 @@ int tcp_server_init(void)
         }
         // send welcome message to the client
         const char *welcome_msg = "Welcome to Remote I/O!\r\n";
-        ret = ethernet_if_send(service, "%s", welcome_msg);
+        ret = ethernet_if_send_raw_bytes(service, (const uint8_t *)welcome_msg, strlen(welcome_msg));
         if (ret < 0) {
             LOG_ERR("Failed to send welcome message: %d", -errno);
-            unregister_client_at_socket_service(client);
             close_socket_service(service);
+            unregister_client_at_socket_service(client);
             zsock_close(client);
             continue;
         }
@@ -480,15 +566,21 @@ static void reset_socket_service(ethernet_if_socket_service_t *service)
     service->poll_fds.fd = -1; // mark it as unregistered
     service->poll_fds.events = 0;
     service->poll_fds.revents = 0;
+    atomic_set(&service->rx_paused, 0);
     // free RX buffer
     if (service->service_context.rx_buffer->buffer != NULL) {
         free(service->service_context.rx_buffer->buffer);
         service->service_context.rx_buffer->buffer = NULL;
     }
     // reset the buffer pointers
-    service->service_context.rx_buffer->head = 0;
-    service->service_context.rx_buffer->tail = 0;
-    service->service_context.rx_buffer->size = 0;
+    utils_ring_reset(service->service_context.rx_buffer);
+    // drop responses which have not been sent to the previous client,
+    // a notifier such as the UART listener may still be writing to the tx buffer
+    k_mutex_lock(&service->service_context.tx_buffer->lock, K_FOREVER);
+    service->service_context.tx_buffer->length = 0;
+    k_mutex_unlock(&service->service_context.tx_buffer->lock);
+    // every new connection starts with the text protocol
+    service->service_context.protocol = API_PROTOCOL_TEXT;
 
     return;
 }
@@ -502,12 +594,12 @@ static int intialize_socket_service(ethernet_if_socket_service_t *service)
     reset_socket_service(service);
 
     // allocate memory for RX buffer
-    service->service_context.rx_buffer->buffer = malloc(MAX_RX_BUFFER_SIZE);
-    if (service->service_context.rx_buffer->buffer == NULL) {
+    uint8_t *buffer = malloc(RX_RING_BUFFER_SIZE);
+    if (buffer == NULL) {
         LOG_ERR("Failed to allocate memory for RX buffer");
         return -1;
     }
-    service->service_context.rx_buffer->size = MAX_RX_BUFFER_SIZE;
+    utils_ring_init(service->service_context.rx_buffer, buffer, RX_RING_BUFFER_SIZE);
 
     return 0;
 }
@@ -519,6 +611,7 @@ static int create_socket_service_thread(ethernet_if_socket_service_t *service)
     }
     
     // crate the thread
+    atomic_set(&service->service_context.quit, 0);
     service->thread_id = k_thread_create(
         &service->thread,
         service->stack,
@@ -540,11 +633,21 @@ static int close_socket_service(ethernet_if_socket_service_t *service)
     if (service == NULL) {
         return -1;
     }
-    // delete the thread
-    k_thread_abort(service->thread_id);
+    // let the thread end by itself, an aborted thread would keep the tx buffer lock if it holds it;
+    // shut the client down first, so a send blocked on a peer which stopped reading fails at once
+    if (service->poll_fds.fd != -1) {
+        zsock_shutdown(service->poll_fds.fd, ZSOCK_SHUT_RDWR);
+    }
+    atomic_set(&service->service_context.quit, 1);
+    k_event_post(&apiNewDataEvent, service->service_context.event);
+    k_thread_join(&service->thread, K_FOREVER);
 
     // unsubscribe all subscibed inputs
     digital_input_unsubscribe_all((void *)&service->service_context);
+    // free the capture of the connection
+    digital_capture_release((void *)&service->service_context);
+    // stop the output sequence of the connection
+    digital_sequencer_release((void *)&service->service_context);
 
     return 0;
 }
@@ -706,11 +809,15 @@ int ethernet_if_send_raw_bytes(ethernet_if_socket_service_t *service, const uint
         goto exit;
     }
 
-    // send data to the client
-    ret = zsock_send(service->poll_fds.fd, buf, len, 0);
-    if (ret < 0) {
-        LOG_ERR("Failed to send data: %d", -errno);
-        goto exit;
+    // send data to the client, the stack may accept only a part of it
+    size_t sent = 0;
+    while (sent < len) {
+        ret = zsock_send(service->poll_fds.fd, buf + sent, len - sent, 0);
+        if (ret < 0) {
+            LOG_ERR("Failed to send data: %d", -errno);
+            goto exit;
+        }
+        sent += ret;
     }
     LOG_DBG("Sent data: %.*s", len, buf);
 exit:
@@ -720,7 +827,42 @@ exit:
 }
 
 /**
- * @brief   Respond to the client with a formatted string
+ * @brief   Send the accumulated responses, the tx buffer must be locked by the caller
+ * @param   service  pointer to the socket service
+ * @return  void
+ */
+static void ethernet_if_flush_locked(ethernet_if_socket_service_t *service)
+{
+    api_tx_buffer_t *tx = service->service_context.tx_buffer;
+
+    if (tx->length == 0) {
+        return;
+    }
+
+    ethernet_if_send_raw_bytes(service, (const uint8_t *)tx->buffer, tx->length);
+    tx->length = 0;
+}
+
+/**
+ * @brief   Send the accumulated responses to the client in a single send
+ * @param   service  pointer to the socket service
+ * @return  void
+ */
+void ethernet_if_flush(ethernet_if_socket_service_t *service)
+{
+    if (service == NULL) {
+        return;
+    }
+
+    k_mutex_lock(&service->service_context.tx_buffer->lock, K_FOREVER);
+    ethernet_if_flush_locked(service);
+    k_mutex_unlock(&service->service_context.tx_buffer->lock);
+}
+
+/**
+ * @brief   Respond to the client with a formatted string.
+ *          The string is formatted into the tx buffer and sent on the next flush,
+ *          or earlier if the tx buffer runs out of space.
  * @param   service  pointer to the socket service
  * @param   format   format string
  * @return  void
@@ -731,17 +873,33 @@ void ethernet_if_respond_handler(ethernet_if_socket_service_t *service, const ch
         return;
     }
 
-    char buffer[MAX_TX_BUFFER_SIZE] = {'\0'};
+    api_tx_buffer_t *tx = service->service_context.tx_buffer;
     va_list args;
-    va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
-    va_end(args);
 
-    ethernet_if_send(service, "%s", buffer);
+    k_mutex_lock(&tx->lock, K_FOREVER);
+    for (;;) {
+        size_t space = tx->size - tx->length;
+        va_start(args, format);
+        int len = vsnprintf(tx->buffer + tx->length, space, format, args);
+        va_end(args);
+
+        if (len < 0) {
+            break;
+        }
+        // the response fits, or it does not even fit in an empty buffer and gets truncated
+        if ((size_t)len < space || tx->length == 0) {
+            tx->length += MIN((size_t)len, space - 1);
+            break;
+        }
+        // make room by sending the pending responses, then format again
+        ethernet_if_flush_locked(service);
+    }
+    k_mutex_unlock(&tx->lock);
 }
 
 /**
- * @brief   Respond to the client with raw bytes
+ * @brief   Respond to the client with raw bytes.
+ *          The bytes are appended to the tx buffer and sent on the next flush.
  * @param   service  pointer to the socket service
  * @param   buf      pointer to the buffer
  * @param   len      length of the buffer
@@ -753,5 +911,19 @@ void ethernet_if_respond_raw_bytes_handler(ethernet_if_socket_service_t *service
         return;
     }
 
-    ethernet_if_send_raw_bytes(service, buf, len);
+    api_tx_buffer_t *tx = service->service_context.tx_buffer;
+
+    k_mutex_lock(&tx->lock, K_FOREVER);
+    // make room for the bytes
+    if (len > (size_t)(tx->size - tx->length)) {
+        ethernet_if_flush_locked(service);
+    }
+    if (len > tx->size) {
+        // too large to be buffered, send it directly
+        ethernet_if_send_raw_bytes(service, buf, len);
+    } else {
+        memcpy(tx->buffer + tx->length, buf, len);
+        tx->length += len;
+    }
+    k_mutex_unlock(&tx->lock);
 }
@@ -7,7 +7,8 @@ LOG_MODULE_REGISTER(flash_storage, LOG_LEVEL_DBG);
 #include "stm32f7xx_remote_io.h"
 #include "flash.h"
 
-#define NUM_FLASH_AREAS 1 // Number of flash areas to bring up
+// flash areas to bring up, storage_partition_1 belongs to the Mender client (src/mender/storage.c)
+#define FLASH_AREAS 0, 2
 
 /**
  * @brief The label for the flash area can be found in the device tree.
@@ -15,6 +16,7 @@ LOG_MODULE_REGISTER(flash_storage, LOG_LEVEL_DBG);
 // storage partition id
 #define STORAGE_PARTITION_0_ID FIXED_PARTITION_ID(storage_partition_0)
 // #define STORAGE_PARTITION_1_ID FIXED_PARTITION_ID(storage_partition_1)
+#define STORAGE_PARTITION_2_ID FIXED_PARTITION_ID(storage_partition_2)
 
 /* Private function prototypes */
 io_status_t flash_erase_sector(const struct flash_area *sector);
@@ -26,9 +28,10 @@ K_EVENT_DEFINE(flashAreaReadyEvent);
 // flash device reference - storage partition
 const struct flash_area *storage_0 = NULL;
 // const struct flash_area *storage_1 = NULL;
+const struct flash_area *storage_2 = NULL;
 
-// used by listify
-#define __BRING_UP_FLASH_AREA(id, _) \
+// used by for each
+#define __BRING_UP_FLASH_AREA(id) \
     if (flash_area_open(STORAGE_PARTITION_##id##_ID, &storage_##id) != 0) \
     { \
         LOG_ERR("Failed to open flash area %d", id); \
@@ -40,9 +43,9 @@ const struct flash_area *storage_0 = NULL;
         flash_area_close(storage_##id); \
         return STATUS_ERROR; \
     }
-#define BRING_UP_FLASH_AREA(N) \
+#define BRING_UP_FLASH_AREA(...) \
     do { \
-        LISTIFY(N, __BRING_UP_FLASH_AREA, ( )) \
+        FOR_EACH(__BRING_UP_FLASH_AREA, ( ), __VA_ARGS__) \
     } while (0)
 
 // initialize the flash device
@@ -62,7 +65,7 @@ io_status_t flash_init(void)
     //     flash_area_close(storage_partition);
     //     return STATUS_ERROR; // flash area device is not ready
     // }
-    BRING_UP_FLASH_AREA(NUM_FLASH_AREAS);
+    BRING_UP_FLASH_AREA(FLASH_AREAS);
 
     // signal that the flash area is ready
     k_event_post(&flashAreaReadyEvent, FLASH_AREA_READY_EVENT);
@@ -108,7 +111,7 @@ io_status_t flash_write_data_with_checksum(const struct flash_area *sector, uint
     // compute checksum
     uint8_t checksum = 0;
     uint8_t *_data = data;
-    uint8_t len = length;
+    size_t len = length;
     for (; len > 0; len--)
     {
         checksum = (checksum << 1) | (checksum >> 7);
@@ -148,7 +151,7 @@ io_status_t flash_read_data_with_checksum(const struct flash_area *sector, uint8
     // compute checksum
     uint8_t checksum = 0;
     uint8_t *_data = data;
-    uint8_t len = length;
+    size_t len = length;
     for (; len > 0; len--)
     {
         checksum = (checksum << 1) | (checksum >> 7);
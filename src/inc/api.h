@@ -1,7 +1,11 @@
 #ifndef __API_H
 #define __API_H
 
+#include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/util.h>
 #include "utils.h"
+#include "uart.h"
 
 // Service ID
 #define SERVICE_ID_STATUS 1
@@ -14,6 +18,13 @@
 #define SERVICE_ID_GPIO_WS28XX_LED 8
 #define SERIVCE_ID_ANALOG_INPUT 9
 #define SERVICE_ID_ANALOG_OUTPUT 10
+#define SERVICE_ID_PROTOCOL 11
+#define SERVICE_ID_EXCHANGE 12
+#define SERVICE_ID_COUNTER 13
+#define SERVICE_ID_CAPTURE 14
+#define SERVICE_ID_SEQUENCER 15
+#define SERVICE_ID_REFLEX 16
+#define SERVICE_ID_SCAN 17
 
 // Setting ID
 #define SETTING_ID_IP_ADDRESS 101
@@ -27,6 +38,16 @@
 #define SETTING_ID_STOP_BITS 109
 #define SETTING_ID_FLOW_CONTROL 110
 #define SETTING_ID_NUMBER_OF_LEDS 111
+#define SETTING_ID_DEBOUNCE 112
+
+// maximum number of characters of a number parameter, 1 for sign, 1 for null terminator
+#define API_PARAM_STR_MAX_LENGTH (MAX_INT_DIGITS + 2)
+
+// maximum length of the raw data carried by one command line, e.g. "W7 <Length> <Data>"
+#define API_DATA_MAX_LENGTH CONFIG_REMOTEIO_API_DATA_BUFFER_SIZE
+
+// maximum number of parameters carried by one command line
+#define API_MAX_TOKENS CONFIG_REMOTEIO_API_MAX_TOKENS
 
 enum {
     TOKEN_TYPE_PARAM = 1,
@@ -39,41 +60,54 @@ enum {
     PARAM_TYPE_ANY,
 };
 
-/* Macros */
-// remove all the blank spaces when processing the command
-#define API_REMOVE_BLANK_SPACES(SERV) \
-    do { \
-        while (((SERV)->rx_buffer->head != (SERV)->rx_buffer->tail) \
-                && (SERV)->rx_buffer->buffer[(SERV)->rx_buffer->tail] == ' ') { \
-            api_increment_rx_buffer_tail_or_wait((SERV)->rx_buffer, (SERV)->event); \
-        } \
-    } while (0)
+// protocol spoken on a connection, switched by the command W11 <protocol>
+enum {
+    API_PROTOCOL_TEXT = 0,
+    API_PROTOCOL_BINARY,
+};
 
-// wait until rx buffer is not empty
-#define API_WAIT_UNTIL_BUFFER_NOT_EMPTY(SERV, EVENT_POINTER) \
-    do { \
-        while (utils_is_buffer_empty((SERV)->rx_buffer) == STATUS_OK) { \
-            k_event_wait((EVENT_POINTER), (SERV)->event, true, K_FOREVER); \
-        } \
-    } while (0)
+// binary frame
+// layout: <sync> <flags> <id> <variant> <length> <crc> <payload>
+// all the fields and the int32 parameters in the payload are little-endian.
+// crc is CRC-16/CCITT (seed 0xffff) over the header without the crc field, followed by the payload.
+#define API_FRAME_SYNC 0xA5
+#define API_FRAME_FLAG_WRITE (1 << 0) // write command if set, otherwise read command
+#define API_FRAME_FLAG_RESPONSE (1 << 1) // frame is a response to a command
+#define API_FRAME_FLAG_ERROR (1 << 2) // response carries an error code
+#define API_FRAME_FLAG_NOTIFY (1 << 3) // frame is an unsolicited notification
+#define API_FRAME_MAX_PAYLOAD MAX(API_MAX_TOKENS * sizeof(int32_t), API_DATA_MAX_LENGTH)
 
-// default response to client
+/* Macros */
+// default response to client, e.g. "W4 OK"
 #define API_DEFAULT_RESPONSE(SERV, CMD_TYPE, CMD_ID) \
     do { \
-        (SERV)->response_cb((SERV)->user_data, "%c%d OK\r\n", (CMD_TYPE), (CMD_ID)); \
+        api_response_begin((SERV), (CMD_TYPE), (CMD_ID)); \
+        api_response_append_str((SERV), "OK"); \
+        api_response_end((SERV)); \
     } while (0)
 
 
 /* Type definition */
 typedef void (*api_response_callback_t)(void *user_data, ...);
+typedef void (*api_flush_callback_t)(void *user_data);
 
-typedef struct APIServiceContext {
-    struct UtilsRingBuffer *rx_buffer; // rx ring buffer
-    uint32_t event; // event for receiving new data
-    api_response_callback_t response_cb; // callback function for response, which is used to send string
-    api_response_callback_t response_cb_bytes; // callback function for response, which is used to send bytes 
-    void *user_data; // user data for callback function
-} api_service_context_t;
+// tx buffer accumulating responses until they are flushed to the client
+typedef struct APITxBuffer {
+    char *buffer; // buffer pointer
+    uint16_t size; // buffer size
+    uint16_t length; // number of bytes waiting to be sent
+    uint16_t response_start; // start of the response being built by api_response_begin
+    struct k_mutex lock; // responses are written by the service thread and by notifiers
+} api_tx_buffer_t;
+
+typedef struct __packed {
+    uint8_t sync; // API_FRAME_SYNC
+    uint8_t flags; // API_FRAME_FLAG_*
+    uint16_t id; // service id or setting id
+    uint16_t variant; // command variant
+    uint16_t length; // length of the payload
+    uint16_t crc; // crc of the header and the payload
+} api_frame_header_t;
 
 typedef struct Token {
     uint8_t type;
@@ -94,11 +128,69 @@ typedef struct {
     uint16_t variant; // command variant
     token_t *token; // parameters
     token_t *last_token; // last token, the end of the linked list
+    uint8_t token_count; // number of tokens taken from the token pool
+    token_t token_pool[API_MAX_TOKENS]; // statically sized storage for the parameters
 } command_line_t;
 
+// state of the command parser
+enum {
+    API_PARSER_STATE_TYPE = 0, // waiting for the command type
+    API_PARSER_STATE_ID, // lexing the command id
+    API_PARSER_STATE_VARIANT, // lexing the command variant
+    API_PARSER_STATE_PARAM_START, // skipping blank spaces before a parameter
+    API_PARSER_STATE_PARAM, // lexing a number
+    API_PARSER_STATE_ANY, // copying raw data of the length given by the previous parameter
+    API_PARSER_STATE_ANY_END, // waiting for the end of line after raw data
+    API_PARSER_STATE_DISCARD, // skipping the rest of an invalid command line
+    API_PARSER_STATE_FRAME_SYNC, // hunting for the start of a binary frame
+    API_PARSER_STATE_FRAME_HEADER, // receiving the header of a binary frame
+    API_PARSER_STATE_FRAME_PAYLOAD, // receiving the payload of a binary frame
+};
+
+// resumable command parser, it is fed with whatever bytes have been received
+// and keeps its state between the feeds instead of waiting for the rest of a command
+typedef struct {
+    uint8_t state; // API_PARSER_STATE_*
+    uint8_t param_length; // number of characters in param_str
+    bool is_decimal; // the number being lexed has a decimal point
+    uint16_t received; // bytes received for the current raw data, frame header or payload
+    uint16_t remaining; // bytes left of the current raw data or frame payload
+    char param_str[API_PARAM_STR_MAX_LENGTH]; // characters of the number being lexed
+    api_frame_header_t header; // header of the binary frame being received
+    uint8_t payload[API_FRAME_MAX_PAYLOAD]; // payload of the binary frame or raw data of the text command being received
+    command_line_t command_line; // command line being built
+} api_parser_t;
+
+typedef struct APIServiceContext {
+    utils_ring_t *rx_buffer; // rx ring buffer, filled by the transport and drained by api_task
+    api_tx_buffer_t *tx_buffer; // tx buffer for accumulating responses
+    uint32_t event; // event for receiving new data
+    api_response_callback_t response_cb; // callback function for response, which is used to send string
+    api_response_callback_t response_cb_bytes; // callback function for response, which is used to send bytes 
+    api_flush_callback_t flush_cb; // callback function to send the accumulated responses
+    api_flush_callback_t rx_resume_cb; // callback function called when rx buffer space has been freed, may be NULL
+    void *user_data; // user data for callback function
+    uint8_t protocol; // API_PROTOCOL_TEXT or API_PROTOCOL_BINARY
+    atomic_t quit; // set by the transport to end api_task, followed by the event
+    api_parser_t parser; // parser of the received data
+} api_service_context_t;
+
 /* Function prototypes */
 void api_init();
 void api_task(void *p1, void *p2, void *p3);
-void api_increment_rx_buffer_tail_or_wait(utils_ring_buffer_t *ring_buf, uint32_t event);
+void api_send_frame(api_service_context_t *service, uint8_t flags, uint16_t id, uint16_t variant,
+                    const uint8_t *payload, uint16_t length);
+void api_response_begin(api_service_context_t *service, char prefix, uint16_t id);
+void api_response_append_variant(api_service_context_t *service, uint16_t variant);
+void api_response_append_int(api_service_context_t *service, int32_t value);
+void api_response_append_mask(api_service_context_t *service, uint32_t mask);
+void api_response_append_str(api_service_context_t *service, const char *str);
+void api_response_append_bytes(api_service_context_t *service, const uint8_t *data, uint16_t length);
+void api_response_end(api_service_context_t *service);
+void api_response_write(api_service_context_t *service, const char *text, uint16_t length);
+void api_respond_values(api_service_context_t *service, command_line_t *command_line,
+                        bool with_variant, const int32_t *values, uint8_t count);
+void api_error(api_service_context_t *service, uint16_t error_code);
+void api_notify(api_service_context_t *service);
 
 #endif
\ No newline at end of file
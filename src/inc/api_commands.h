@@ -0,0 +1,186 @@
+#ifndef __API_COMMANDS_H
+#define __API_COMMANDS_H
+
+#include "api.h"
+
+// access rights of a command
+#define API_ACCESS_R (1 << 0) // command can be read, e.g. "R3 1"
+#define API_ACCESS_W (1 << 1) // command can be written, e.g. "W4 1 1"
+#define API_ACCESS_RW (API_ACCESS_R | API_ACCESS_W)
+
+// the highest id that can be registered in the command registry
+#define API_COMMAND_ID_MAX 127
+
+// variants of the input command
+#define API_INPUT_VARIANT_STATE 0 // state of one or all inputs, e.g. "R3 1" or "R3 -1"
+#define API_INPUT_VARIANT_LATCHED 1 // read and clear the latched edges of all inputs, e.g. "R3.1"
+
+// variants of the output command
+#define API_OUTPUT_VARIANT_SINGLE 0 // state of one or all outputs, e.g. "R4 1", or write one output, e.g. "W4 1 1"
+#define API_OUTPUT_VARIANT_MULTIPLE 1 // write consecutive outputs, e.g. "W4.1 5 1 3"
+#define API_OUTPUT_VARIANT_VERIFY 2 // verify the outputs against the ports, e.g. "W4.2 1" or "R4.2"
+#define API_OUTPUT_VARIANT_PULSE 3 // timed pulses on one output, e.g. "W4.3 1 50" or "W4.3 1 50 950 10"
+
+// variants of the subscribe command and its notifications
+#define API_SUBSCRIBE_VARIANT_INPUTS 0 // subscribe to inputs, e.g. "W5 1 2", or notification of an input, e.g. "S5 1 1"
+#define API_SUBSCRIBE_VARIANT_COALESCED 1 // coalesced notifications, e.g. "W5.1 1 10"
+#define API_SUBSCRIBE_VARIANT_DROPPED 2 // notification of lost events, e.g. "S5.2 3"
+
+// variants of the counter command
+#define API_COUNTER_VARIANT_COUNT 0 // counters of all inputs, e.g. "R13", or counter mode, e.g. "W13 1 1"
+#define API_COUNTER_VARIANT_CLEAR 1 // read and clear the counters of all inputs, e.g. "R13.1"
+#define API_COUNTER_VARIANT_FREQUENCY 2 // frequencies of all inputs, e.g. "R13.2", or gate time, e.g. "W13.2 100"
+#define API_COUNTER_VARIANT_WIDE 3 // 64-bit counter of one input, e.g. "R13.3 1"
+
+// variants of the capture command and its notifications
+#define API_CAPTURE_VARIANT_START 0 // start a capture, e.g. "W14 10 100000 1 1", or records, e.g. "S14 8 <Records>"
+#define API_CAPTURE_VARIANT_STOP 1 // stop the capture, e.g. "W14.1", or end of the capture, e.g. "S14.1 100000 0"
+
+// variants of the sequencer command and its notifications
+#define API_SEQUENCER_VARIANT_LOAD 0 // append steps to the loaded table, e.g. "W15 10 1 0 10 0 1"
+#define API_SEQUENCER_VARIANT_CLEAR 1 // empty the loaded table, e.g. "W15.1"
+#define API_SEQUENCER_VARIANT_START 2 // play or queue the loaded table, e.g. "W15.2 1", or end of a table, e.g. "S15.2 3"
+#define API_SEQUENCER_VARIANT_STOP 3 // stop the playback, e.g. "W15.3", or underrun, e.g. "S15.3 3"
+
+// variants of the reflex command
+#define API_REFLEX_VARIANT_RULE 0 // set or read a rule, e.g. "W16 1 16 0 3 2" or "R16 1"
+#define API_REFLEX_VARIANT_ENABLE 1 // enable or disable all rules, e.g. "W16.1 1"
+#define API_REFLEX_VARIANT_DELETE 2 // delete one or all rules, e.g. "W16.2 1" or "W16.2"
+#define API_REFLEX_VARIANT_SAVE 3 // save the rules in flash, e.g. "W16.3"
+
+// variants of the scan command
+#define API_SCAN_VARIANT_STATISTICS 0 // start or stop the scan engine, e.g. "W17 1000", or cycle statistics, e.g. "R17"
+#define API_SCAN_VARIANT_JITTER 1 // clear the statistics, e.g. "W17.1", or jitter histogram, e.g. "R17.1"
+#define API_SCAN_VARIANT_IMAGE 2 // process image of the last cycle, e.g. "R17.2"
+
+// maximum length of the records sent in one capture notification, a multiple of the record size
+#define API_CAPTURE_BLOCK_SIZE 256
+
+// variants of the LED command, e.g. "W8.1 0 25 255 0 0"
+#define API_LED_VARIANT_PIXEL 0 // set one LED
+#define API_LED_VARIANT_RANGE 1 // set a range of LEDs to one color
+#define API_LED_VARIANT_LIST 2 // set consecutive LEDs from a list of packed colors
+#define API_LED_VARIANT_FRAME 3 // set all LEDs from a list of packed colors
+#define API_LED_VARIANT_COMMIT 4 // refresh the strip with the staged pixels
+#define API_LED_VARIANT_STAGED 10 // added to a set variant to stage the pixels without refreshing the strip
+
+/**
+ * Command registry
+ * Each entry is expanded by the given macro X with the following arguments:
+ *   X(ID, HANDLER, ACCESS, READ_MIN, READ_MAX, WRITE_MIN, WRITE_MAX, PARAM_TYPE)
+ *   ID         service id or setting id
+ *   HANDLER    function executing the command, see api_command_handler_t
+ *   ACCESS     allowed command types, API_ACCESS_*
+ *   READ_MIN   minimum number of parameters of a read command
+ *   READ_MAX   maximum number of parameters of a read command
+ *   WRITE_MIN  minimum number of parameters of a write command
+ *   WRITE_MAX  maximum number of parameters of a write command
+ *   PARAM_TYPE type of the parameters, PARAM_TYPE_INT32 or PARAM_TYPE_ANY for raw data
+ * The access and the numbers of parameters bound every variant of the command,
+ * the variants of a command listed in API_VARIANT_LIST are narrowed further, see below.
+ * The dispatcher checks the access and the parameters before calling the handler.
+ */
+#define API_COMMAND_LIST(X) \
+    X(SERVICE_ID_STATUS,            api_cmd_status,             API_ACCESS_R,   0, 0, 0, 0, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_SYSTEM_INFO,       api_cmd_system_info,        API_ACCESS_R,   0, 0, 0, 0, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_INPUT,             api_cmd_input,              API_ACCESS_R,   0, 1, 0, 0, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_OUTPUT,            api_cmd_output,             API_ACCESS_RW,  0, 1, 1, 4, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_SUBSCRIBE_INPUT,   api_cmd_subscribe_input,    API_ACCESS_RW,  0, 0, 1, DIGITAL_INPUT_MAX, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_UNSUBSCRIBE_INPUT, api_cmd_unsubscribe_input,  API_ACCESS_W,   0, 0, 1, DIGITAL_INPUT_MAX, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_SERIAL,            api_cmd_serial,             API_ACCESS_W,   0, 0, 2, 2, PARAM_TYPE_ANY) \
+    X(SERVICE_ID_GPIO_WS28XX_LED,   api_cmd_ws28xx_led,         API_ACCESS_RW,  1, 1, 0, API_MAX_TOKENS, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_PROTOCOL,          api_cmd_protocol,           API_ACCESS_RW,  0, 0, 1, 1, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_EXCHANGE,          api_cmd_exchange,           API_ACCESS_RW,  1, 1, 3, 3, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_COUNTER,           api_cmd_counter,            API_ACCESS_RW,  0, 1, 1, 2, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_CAPTURE,           api_cmd_capture,            API_ACCESS_RW,  0, 0, 0, 5, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_SEQUENCER,         api_cmd_sequencer,          API_ACCESS_RW,  0, 0, 0, API_MAX_TOKENS, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_REFLEX,            api_cmd_reflex,             API_ACCESS_RW,  0, 1, 0, 6, PARAM_TYPE_INT32) \
+    X(SERVICE_ID_SCAN,              api_cmd_scan,               API_ACCESS_RW,  0, 0, 0, 1, PARAM_TYPE_INT32) \
+    X(SETTING_ID_IP_ADDRESS,        api_cmd_ip_address,         API_ACCESS_RW,  0, 0, 4, 4, PARAM_TYPE_INT32) \
+    X(SETTING_ID_TCP_PORT,          api_cmd_tcp_port,           API_ACCESS_RW,  0, 0, 1, 1, PARAM_TYPE_INT32) \
+    X(SETTING_ID_NETMASK,           api_cmd_netmask,            API_ACCESS_RW,  0, 0, 4, 4, PARAM_TYPE_INT32) \
+    X(SETTING_ID_GATEWAY,           api_cmd_gateway,            API_ACCESS_RW,  0, 0, 4, 4, PARAM_TYPE_INT32) \
+    X(SETTING_ID_MAC_ADDRESS,       api_cmd_mac_address,        API_ACCESS_RW,  0, 0, 6, 6, PARAM_TYPE_INT32) \
+    X(SETTING_ID_BAUD_RATE,         api_cmd_baud_rate,          API_ACCESS_RW,  0, 0, 1, 1, PARAM_TYPE_INT32) \
+    X(SETTING_ID_DEBOUNCE,          api_cmd_debounce,           API_ACCESS_RW,  0, 0, 2, 2, PARAM_TYPE_INT32)
+
+/**
+ * Variant list
+ * Each entry is expanded by the given macro V with the following arguments:
+ *   V(ID, VARIANT, ACCESS, READ_MIN, READ_MAX, WRITE_MIN, WRITE_MAX)
+ *   ID         service id of a command in the registry
+ *   VARIANT    command variant, API_<SERVICE>_VARIANT_*
+ *   ACCESS     allowed command types of the variant, API_ACCESS_*
+ *   READ_MIN ... WRITE_MAX numbers of parameters of the variant, within those of the registry entry
+ * A command with entries in the list only accepts the listed variants, any other variant is invalid;
+ * the variants of a command without entries, e.g. the UART index of "W7.<UART Index>", are checked by its handler.
+ * Counts which are not a range, e.g. a multiple of 3, and the values of the parameters are checked by the handler.
+ */
+#define API_VARIANT_LIST(V) \
+    V(SERVICE_ID_INPUT,           API_INPUT_VARIANT_STATE,            API_ACCESS_R,   1, 1, 0, 0) \
+    V(SERVICE_ID_INPUT,           API_INPUT_VARIANT_LATCHED,          API_ACCESS_R,   0, 0, 0, 0) \
+    V(SERVICE_ID_OUTPUT,          API_OUTPUT_VARIANT_SINGLE,          API_ACCESS_RW,  1, 1, 2, 2) \
+    V(SERVICE_ID_OUTPUT,          API_OUTPUT_VARIANT_MULTIPLE,        API_ACCESS_W,   0, 0, 3, 3) \
+    V(SERVICE_ID_OUTPUT,          API_OUTPUT_VARIANT_VERIFY,          API_ACCESS_RW,  0, 0, 1, 1) \
+    V(SERVICE_ID_OUTPUT,          API_OUTPUT_VARIANT_PULSE,           API_ACCESS_RW,  0, 0, 2, 4) \
+    V(SERVICE_ID_SUBSCRIBE_INPUT, API_SUBSCRIBE_VARIANT_INPUTS,       API_ACCESS_RW,  0, 0, 1, DIGITAL_INPUT_MAX) \
+    V(SERVICE_ID_SUBSCRIBE_INPUT, API_SUBSCRIBE_VARIANT_COALESCED,    API_ACCESS_RW,  0, 0, 2, 2) \
+    V(SERVICE_ID_GPIO_WS28XX_LED, API_LED_VARIANT_PIXEL,              API_ACCESS_RW,  1, 1, 4, 4) \
+    V(SERVICE_ID_GPIO_WS28XX_LED, API_LED_VARIANT_RANGE,              API_ACCESS_W,   0, 0, 5, 5) \
+    V(SERVICE_ID_GPIO_WS28XX_LED, API_LED_VARIANT_LIST,               API_ACCESS_W,   0, 0, 2, API_MAX_TOKENS) \
+    V(SERVICE_ID_GPIO_WS28XX_LED, API_LED_VARIANT_FRAME,              API_ACCESS_W,   0, 0, 1, API_MAX_TOKENS) \
+    V(SERVICE_ID_GPIO_WS28XX_LED, API_LED_VARIANT_COMMIT,             API_ACCESS_W,   0, 0, 0, 0) \
+    V(SERVICE_ID_GPIO_WS28XX_LED, API_LED_VARIANT_STAGED + API_LED_VARIANT_PIXEL, API_ACCESS_W, 0, 0, 4, 4) \
+    V(SERVICE_ID_GPIO_WS28XX_LED, API_LED_VARIANT_STAGED + API_LED_VARIANT_RANGE, API_ACCESS_W, 0, 0, 5, 5) \
+    V(SERVICE_ID_GPIO_WS28XX_LED, API_LED_VARIANT_STAGED + API_LED_VARIANT_LIST,  API_ACCESS_W, 0, 0, 2, API_MAX_TOKENS) \
+    V(SERVICE_ID_GPIO_WS28XX_LED, API_LED_VARIANT_STAGED + API_LED_VARIANT_FRAME, API_ACCESS_W, 0, 0, 1, API_MAX_TOKENS) \
+    V(SERVICE_ID_COUNTER,         API_COUNTER_VARIANT_COUNT,          API_ACCESS_RW,  0, 0, 2, 2) \
+    V(SERVICE_ID_COUNTER,         API_COUNTER_VARIANT_CLEAR,          API_ACCESS_R,   0, 0, 0, 0) \
+    V(SERVICE_ID_COUNTER,         API_COUNTER_VARIANT_FREQUENCY,      API_ACCESS_RW,  0, 0, 1, 1) \
+    V(SERVICE_ID_COUNTER,         API_COUNTER_VARIANT_WIDE,           API_ACCESS_R,   1, 1, 0, 0) \
+    V(SERVICE_ID_CAPTURE,         API_CAPTURE_VARIANT_START,          API_ACCESS_RW,  0, 0, 2, 5) \
+    V(SERVICE_ID_CAPTURE,         API_CAPTURE_VARIANT_STOP,           API_ACCESS_W,   0, 0, 0, 0) \
+    V(SERVICE_ID_SEQUENCER,       API_SEQUENCER_VARIANT_LOAD,         API_ACCESS_RW,  0, 0, 3, API_MAX_TOKENS) \
+    V(SERVICE_ID_SEQUENCER,       API_SEQUENCER_VARIANT_CLEAR,        API_ACCESS_W,   0, 0, 0, 0) \
+    V(SERVICE_ID_SEQUENCER,       API_SEQUENCER_VARIANT_START,        API_ACCESS_W,   0, 0, 1, 1) \
+    V(SERVICE_ID_SEQUENCER,       API_SEQUENCER_VARIANT_STOP,         API_ACCESS_W,   0, 0, 0, 0) \
+    V(SERVICE_ID_REFLEX,          API_REFLEX_VARIANT_RULE,            API_ACCESS_RW,  0, 1, 5, 6) \
+    V(SERVICE_ID_REFLEX,          API_REFLEX_VARIANT_ENABLE,          API_ACCESS_W,   0, 0, 1, 1) \
+    V(SERVICE_ID_REFLEX,          API_REFLEX_VARIANT_DELETE,          API_ACCESS_W,   0, 0, 0, 1) \
+    V(SERVICE_ID_REFLEX,          API_REFLEX_VARIANT_SAVE,            API_ACCESS_W,   0, 0, 0, 0) \
+    V(SERVICE_ID_SCAN,            API_SCAN_VARIANT_STATISTICS,        API_ACCESS_RW,  0, 0, 1, 1) \
+    V(SERVICE_ID_SCAN,            API_SCAN_VARIANT_JITTER,            API_ACCESS_RW,  0, 0, 0, 0) \
+    V(SERVICE_ID_SCAN,            API_SCAN_VARIANT_IMAGE,             API_ACCESS_R,   0, 0, 0, 0)
+
+/* Type definition */
+// execute a validated command, return 0 on success or an API error code
+typedef uint16_t (*api_command_handler_t)(api_service_context_t *service, command_line_t *command_line);
+
+// access and numbers of parameters of a command or of one of its variants
+typedef struct {
+    uint8_t access; // allowed command types
+    uint8_t read_params_min; // minimum number of parameters of a read command
+    uint8_t read_params_max; // maximum number of parameters of a read command
+    uint8_t write_params_min; // minimum number of parameters of a write command
+    uint8_t write_params_max; // maximum number of parameters of a write command
+} api_command_params_t;
+
+typedef struct {
+    api_command_handler_t handler; // NULL if the id is not registered
+    api_command_params_t params; // bounds of every variant
+    uint8_t param_type; // type of the parameters
+} api_command_t;
+
+typedef struct {
+    uint16_t id; // service id
+    uint16_t variant; // command variant
+    api_command_params_t params; // parameters of the variant
+} api_command_variant_t;
+
+/* Function prototypes */
+const api_command_t *api_command_get(uint16_t id);
+uint16_t api_command_check(const api_command_t *command, const command_line_t *command_line);
+uint16_t api_command_unknown(api_service_context_t *service, command_line_t *command_line);
+void api_send_notifications(api_service_context_t *service);
+
+#endif
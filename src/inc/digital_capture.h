@@ -0,0 +1,47 @@
+#ifndef __DIGITAL_CAPTURE_H
+#define __DIGITAL_CAPTURE_H
+
+#include "stm32f7xx_remote_io.h"
+#include "digital_input.h"
+
+// sample period in us, the timer runs on the system tick, so the period must be a whole number of ticks
+#define DIGITAL_CAPTURE_PERIOD_MIN 10
+#define DIGITAL_CAPTURE_PERIOD_MAX 1000000
+
+// state of the capture
+#define DIGITAL_CAPTURE_STATE_IDLE 0 // no capture
+#define DIGITAL_CAPTURE_STATE_ARMED 1 // sampling, waiting for the trigger
+#define DIGITAL_CAPTURE_STATE_RUNNING 2 // triggered, recording samples
+#define DIGITAL_CAPTURE_STATE_DONE 3 // all samples recorded or stopped, records left to read
+
+/* type definition */
+// one run of identical samples, sent little-endian as is
+typedef struct __packed DigitalCaptureRecord {
+	uint16_t state; // state of all inputs
+	uint16_t count; // number of consecutive samples with this state
+} digital_capture_record_t;
+
+typedef struct DigitalCaptureConfig {
+	uint32_t period; // sample period in us
+	uint32_t samples; // number of samples recorded after the trigger
+	uint32_t trigger_mask; // inputs compared with trigger_value, 0 triggers at once
+	uint32_t trigger_value; // state of the masked inputs starting the capture
+	uint32_t trigger_edges; // inputs that must change with the triggering sample, 0 for a level trigger
+} digital_capture_config_t;
+
+typedef struct DigitalCaptureStatus {
+	uint8_t state; // DIGITAL_CAPTURE_STATE_*
+	uint32_t samples; // samples recorded since the trigger
+	uint32_t dropped; // records lost because the buffer was full
+} digital_capture_status_t;
+
+/* public functions */
+io_status_t digital_capture_start(void *user_data, digital_input_notify_fn_t notify,
+				  const digital_capture_config_t *config);
+void digital_capture_stop(void *user_data);
+void digital_capture_release(void *user_data);
+bool digital_capture_is_owner(void *user_data);
+uint32_t digital_capture_read(void *user_data, uint8_t *data, uint32_t length);
+void digital_capture_get_status(digital_capture_status_t *status);
+
+#endif
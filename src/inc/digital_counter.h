@@ -0,0 +1,27 @@
+#ifndef __DIGITAL_COUNTER_H
+#define __DIGITAL_COUNTER_H
+
+#include "stm32f7xx_remote_io.h"
+
+// edges counted by a counter
+#define DIGITAL_COUNTER_MODE_OFF 0
+#define DIGITAL_COUNTER_MODE_RISING 1
+#define DIGITAL_COUNTER_MODE_FALLING 2
+#define DIGITAL_COUNTER_MODE_BOTH (DIGITAL_COUNTER_MODE_RISING | DIGITAL_COUNTER_MODE_FALLING)
+
+// gate time of the frequency measurement in ms
+#define DIGITAL_COUNTER_GATE_TIME_MIN 10
+#define DIGITAL_COUNTER_GATE_TIME_MAX 10000
+#define DIGITAL_COUNTER_GATE_TIME_DEFAULT 1000
+
+/* public functions */
+void digital_counter_count(uint32_t rising, uint32_t falling);
+uint32_t digital_counter_inputs(void);
+io_status_t digital_counter_set_mode(uint8_t index, uint8_t mode);
+uint8_t digital_counter_get_mode(uint8_t index);
+uint64_t digital_counter_read(uint8_t index, bool clear);
+io_status_t digital_counter_set_gate_time(uint16_t gate_time);
+uint16_t digital_counter_get_gate_time(void);
+uint32_t digital_counter_get_frequency(uint8_t index);
+
+#endif
@@ -11,7 +11,17 @@ typedef struct DigitalInput
     bool state;
 } digital_input_t;
 
-typedef void (*digital_input_callback_fn_t)(void *user_data, ...);
+// change of subscribed inputs, queued for each subscriber
+typedef struct DigitalInputEvent {
+    uint32_t timestamp; // time of the (last) change in microseconds since boot, wraps at 2^32
+    uint32_t sequence; // counts the events of a subscriber, dropped events leave a gap
+    uint32_t changed; // changed inputs, a single bit unless coalesced
+    uint32_t state; // state of the subscribed inputs after the change
+    bool coalesced; // all changes within a coalescing window
+} digital_input_event_t;
+
+// called without blocking after events are queued for a subscriber
+typedef void (*digital_input_notify_fn_t)(void *user_data);
 
 /* Macros */
 #define CREATE_DIGITAL_INPUT_INSTANCE(index) \
@@ -29,9 +39,18 @@ typedef void (*digital_input_callback_fn_t)(void *user_data, ...);
 io_status_t digital_input_init();
 bool digital_input_read(uint8_t index);
 uint32_t digital_input_read_all();
-void digital_input_subscribe(void *user_data, uint8_t index, digital_input_callback_fn_t callback);
+uint32_t digital_input_read_latched(uint32_t *rising, uint32_t *falling);
+io_status_t digital_input_subscribe(void *user_data, uint8_t index, digital_input_notify_fn_t notify);
 void digital_input_unsubscribe(void *user_data, uint8_t index);
 void digital_input_unsubscribe_all(void *user_data);
-void digital_input_print_subscribed_inputs(void *user_data, digital_input_callback_fn_t callback);
+uint32_t digital_input_get_subscribed(void *user_data);
+io_status_t digital_input_set_coalescing(void *user_data, bool coalesced, uint16_t window);
+bool digital_input_get_coalescing(void *user_data, uint16_t *window);
+bool digital_input_get_event(void *user_data, digital_input_event_t *event);
+uint32_t digital_input_take_dropped(void *user_data);
+void digital_input_set_debounce(uint8_t index, uint8_t time);
+uint32_t digital_input_debounce(uint32_t raw, uint32_t now);
+void digital_input_set_irq_edges(uint8_t index, bool to_active, bool to_inactive);
+void digital_input_wake_up(void);
 
 #endif
\ No newline at end of file
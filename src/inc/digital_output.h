@@ -10,7 +10,14 @@
 void digital_output_init();
 int digital_output_read(uint8_t index);
 uint32_t digital_output_read_all();
+int digital_output_read_hardware(uint32_t *data);
+void digital_output_set_verify(bool enable);
+bool digital_output_get_verify(uint32_t *mismatches, uint32_t *outputs);
 int digital_output_write(uint8_t index, bool state);
 int digital_output_write_multiple(uint32_t data, uint8_t start_index, uint8_t length);
+int digital_output_write_masked(uint32_t mask, uint32_t data);
+int digital_output_pulse(uint8_t index, uint32_t on_time, uint32_t off_time, uint32_t count);
+void digital_output_pulse_stop(uint32_t mask);
+uint32_t digital_output_get_pulsing(void);
 
 #endif
\ No newline at end of file
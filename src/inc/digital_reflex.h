@@ -0,0 +1,41 @@
+#ifndef __DIGITAL_REFLEX_H
+#define __DIGITAL_REFLEX_H
+
+#include "stm32f7xx_remote_io.h"
+
+// number of rules in the table
+#define DIGITAL_REFLEX_RULES_MAX CONFIG_REMOTEIO_DIGITAL_REFLEX_RULES
+
+// Note: please modify the version whenever there is a change in the rule table structure.
+#define DIGITAL_REFLEX_VERSION 1
+
+// action of a rule on its output
+#define DIGITAL_REFLEX_ACTION_SET 0 // the output becomes active when the condition is met
+#define DIGITAL_REFLEX_ACTION_CLEAR 1 // the output becomes inactive when the condition is met
+#define DIGITAL_REFLEX_ACTION_FOLLOW 2 // the output is active while the condition is met
+#define DIGITAL_REFLEX_ACTION_FOLLOW_INVERTED 3 // the output is inactive while the condition is met
+
+/* type definition */
+// a rule as stored in flash
+typedef struct DigitalReflexRule {
+	uint16_t input_mask; // inputs of the condition
+	uint16_t input_value; // state of the masked inputs meeting the condition
+	uint8_t output; // index of the output
+	uint8_t action; // DIGITAL_REFLEX_ACTION_*
+	uint16_t delay; // ms the condition must be met or not met before the action is taken
+} digital_reflex_rule_t;
+
+/* public functions */
+io_status_t digital_reflex_init(void);
+io_status_t digital_reflex_set_rule(uint8_t index, const digital_reflex_rule_t *rule);
+io_status_t digital_reflex_get_rule(uint8_t index, digital_reflex_rule_t *rule);
+io_status_t digital_reflex_delete_rule(uint8_t index);
+void digital_reflex_delete_all(void);
+uint8_t digital_reflex_count(void);
+void digital_reflex_enable(bool enable);
+bool digital_reflex_is_enabled(void);
+io_status_t digital_reflex_save(void);
+uint32_t digital_reflex_inputs(void);
+void digital_reflex_evaluate(uint32_t state, uint32_t now);
+
+#endif
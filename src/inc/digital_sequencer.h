@@ -0,0 +1,45 @@
+#ifndef __DIGITAL_SEQUENCER_H
+#define __DIGITAL_SEQUENCER_H
+
+#include "stm32f7xx_remote_io.h"
+#include "digital_input.h"
+
+// number of steps of one table
+#define DIGITAL_SEQUENCER_STEPS_MAX CONFIG_REMOTEIO_DIGITAL_SEQUENCER_STEPS
+
+// playback mode of a table
+#define DIGITAL_SEQUENCER_MODE_ONCE 0 // play the table once
+#define DIGITAL_SEQUENCER_MODE_LOOP 1 // repeat the table until stopped or replaced by the next table
+#define DIGITAL_SEQUENCER_MODE_STREAM 2 // continue with the next table, an underrun stops the playback
+
+// events reported to the owner, see digital_sequencer_take_events()
+#define DIGITAL_SEQUENCER_EVENT_DONE BIT(0) // a table has been played to its end
+#define DIGITAL_SEQUENCER_EVENT_UNDERRUN BIT(1) // a streamed table ended without a next table
+
+/* type definition */
+typedef struct DigitalSequencerStep {
+	uint32_t delta_time; // ms after the previous step, or after the start for the first step
+	uint32_t set_mask; // outputs becoming active
+	uint32_t clear_mask; // outputs becoming inactive, unless they are set as well
+} digital_sequencer_step_t;
+
+typedef struct DigitalSequencerStatus {
+	bool playing; // a table is being played
+	uint8_t mode; // DIGITAL_SEQUENCER_MODE_* of the playback
+	uint16_t step; // index of the next step of the playing table
+	uint32_t passes; // tables played to their end since the start
+	uint16_t loaded; // number of steps in the table being loaded
+	bool queued; // the loaded table waits for the end of the playing table
+} digital_sequencer_status_t;
+
+/* public functions */
+io_status_t digital_sequencer_load(void *user_data, const digital_sequencer_step_t *steps, uint16_t count);
+io_status_t digital_sequencer_clear(void *user_data);
+io_status_t digital_sequencer_start(void *user_data, digital_input_notify_fn_t notify, uint8_t mode);
+void digital_sequencer_stop(void *user_data);
+void digital_sequencer_release(void *user_data);
+bool digital_sequencer_is_owner(void *user_data);
+uint32_t digital_sequencer_take_events(void *user_data);
+void digital_sequencer_get_status(digital_sequencer_status_t *status);
+
+#endif
@@ -1,8 +1,6 @@
 #ifndef __ERROR_CODE_H
 #define __ERROR_CODE_H
 
-#define ERROR_CODE_FORMAT "ERR%d\r\n"
-
 /* Error code */
 // API error code
 #define API_ERROR_CODE_FAIL_ALLOCATE_MEMORY_FOR_TOKEN 200
@@ -26,5 +24,15 @@
 #define API_ERROR_CODE_UPDATE_LED_FAILED 218
 #define API_ERROR_CODE_WRITE_DIGITAL_OUTPUT_FAILED 219
 #define API_ERROR_CODE_GET_LED_COLOR_FAILED 220
+#define API_ERROR_CODE_INVALID_FRAME_CRC 221
+#define API_ERROR_CODE_INVALID_FRAME_LENGTH 222
+#define API_ERROR_CODE_NOT_SUPPORTED_IN_BINARY_MODE 223
+#define API_ERROR_CODE_SUBSCRIBE_INPUT_FAILED 224
+#define API_ERROR_CODE_UPDATE_DEBOUNCE_FAILED 225
+#define API_ERROR_CODE_START_CAPTURE_FAILED 226
+#define API_ERROR_CODE_LOAD_SEQUENCE_FAILED 227
+#define API_ERROR_CODE_START_SEQUENCE_FAILED 228
+#define API_ERROR_CODE_UPDATE_REFLEX_FAILED 229
+#define API_ERROR_CODE_SAVE_REFLEX_FAILED 230
 
 #endif
\ No newline at end of file
@@ -31,6 +31,8 @@ typedef struct ethernet_if_socket_service {
         api_service_context_t service_context;
         struct zsock_pollfd poll_fds;
         const struct net_socket_service_desc *service;
+        // POLLIN is disarmed because the rx buffer is full, api_task re-arms it
+        atomic_t rx_paused;
         // pointer to the thread that is processing the socket service
         struct k_thread thread;
         // thread id
@@ -5,9 +5,11 @@
 #include "stm32f7xx_remote_io.h"
 
 extern const struct flash_area *storage_0;
+extern const struct flash_area *storage_2;
 
 // please refer to the reference manual for the flash sector
 #define FLASH_SECTOR_SETTINGS   storage_0
+#define FLASH_SECTOR_REFLEX     storage_2
 
 // flash area ready event
 #define FLASH_AREA_READY_EVENT  (1 << 0)
@@ -0,0 +1,42 @@
+#ifndef __IO_SCAN_H
+#define __IO_SCAN_H
+
+#include "stm32f7xx_remote_io.h"
+
+// cycle period in us, the timer resolution is the system tick
+#define IO_SCAN_PERIOD_MIN 100
+#define IO_SCAN_PERIOD_MAX 1000000
+
+// upper bounds of the jitter histogram buckets in us, the last bucket takes the rest
+#define IO_SCAN_JITTER_BUCKETS { 10, 20, 50, 100, 200, 500, 1000, UINT32_MAX }
+#define IO_SCAN_JITTER_BUCKET_COUNT 8
+
+/* type definition */
+typedef struct IoScanStatistics {
+	uint32_t period; // cycle period in us, 0 if the scan engine is stopped
+	uint32_t cycles; // cycles since the start or the last reset
+	uint32_t overruns; // ticks missed because a cycle was late
+	uint32_t cycle_min; // shortest cycle time in us
+	uint32_t cycle_avg; // average cycle time in us
+	uint32_t cycle_max; // longest cycle time in us
+	uint32_t jitter_max; // largest deviation of the time between two cycles from the period in us
+	uint32_t jitter[IO_SCAN_JITTER_BUCKET_COUNT]; // number of cycles per jitter bucket
+} io_scan_statistics_t;
+
+// process image published at the end of each cycle
+typedef struct IoScanImage {
+	uint32_t cycle; // number of the cycle
+	uint32_t inputs; // state of all inputs sampled at the start of the cycle
+	uint32_t outputs; // state of all outputs after the cycle
+} io_scan_image_t;
+
+/* public functions */
+io_status_t io_scan_start(uint32_t period);
+void io_scan_stop(void);
+bool io_scan_is_running(void);
+int io_scan_write(uint32_t mask, uint32_t data);
+void io_scan_get_statistics(io_scan_statistics_t *statistics);
+void io_scan_reset_statistics(void);
+void io_scan_get_image(io_scan_image_t *image);
+
+#endif
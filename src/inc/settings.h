@@ -13,7 +13,7 @@
 
 // Note: please modify the settings version
 // whenever there is a change in the settings structure.
-#define SETTINGS_VERSION 1
+#define SETTINGS_VERSION 2
 
 // type of settings
 typedef struct EthernetSettings
@@ -71,6 +71,8 @@ typedef struct
     uart_settings_t uart[UART_MAX];
     // settings for pwmws288xx at channel 1
     pwmws288xx_settings_t pwmws288xx_1;
+    // debounce time of each digital input in ms, 0 disables the filter
+    uint8_t debounce[DIGITAL_INPUT_MAX];
 } settings_t;
 
 extern settings_t settings;
@@ -2,7 +2,10 @@
 #define __SYSTEM_INFO_H
 
 
-typedef void (*system_info_callback_fn_t)(void *user_data, ...);
+#include <stdint.h>
+
+// called with each line of the system info, the text is not null-terminated
+typedef void (*system_info_callback_fn_t)(void *user_data, const char *text, uint16_t length);
 
 /* Public functions */
 void system_info_print(void *user_data, system_info_callback_fn_t cb);
@@ -30,7 +30,7 @@ typedef enum {
 } uart_index_t;
 
 typedef struct UartContext {
-    utils_ring_buffer_t *rx_buffer; // RX buffer
+    utils_ring_t *rx_buffer; // RX buffer
     volatile uint8_t events; // events set in bit-wise
 } uart_context_t;
 
@@ -38,7 +38,7 @@ typedef struct UartContext {
 
 /* Function prototypes */
 void uart_init();
-int uart_printf(uart_index_t uart_index, const uint8_t *data, uint8_t len);
+int uart_printf(uart_index_t uart_index, const uint8_t *data, uint16_t len);
 int uart_listener_callback_set(uart_index_t uart_index, uart_listen_callback_t callback, void *user_data);
 int uart_listener_callback_remove(uart_index_t uart_index, uart_listen_callback_t callback, void *user_data);
 int uart_user_listener_remove(uart_index_t uart_index, void *user_data);
@@ -3,14 +3,20 @@
 
 #include "stm32f7xx_remote_io.h"
 
+#include <zephyr/sys/atomic.h>
+
 /* Type definitions */
-// Ring buffer
-typedef struct UtilsRingBuffer {
-    char *buffer; // buffer pointer
-    uint8_t head; // head index
-    uint8_t tail; // tail index
-    uint8_t size; // buffer size
-} utils_ring_buffer_t;
+// Single-producer/single-consumer ring buffer
+// The size is a power of two, so indexes are masked instead of wrapped with a modulo.
+// head and tail are free-running counters, head is only written by the producer and
+// tail only by the consumer, so one producer (thread or ISR) and one consumer thread
+// can share the ring without a lock.
+typedef struct UtilsRing {
+    uint8_t *buffer; // buffer pointer
+    uint32_t mask; // buffer size - 1
+    atomic_t head; // number of bytes pushed
+    atomic_t tail; // number of bytes popped
+} utils_ring_t;
 
 // node for linked list
 typedef struct UtilsNode {
@@ -18,23 +24,6 @@ typedef struct UtilsNode {
 } utils_node_t;
 
 /* Macros */
-#define UTILS_INCREMENT_BUFFER_HEAD(HEAD, TAIL, SIZE) \
-    do { \
-        /* overwrite old data */ \
-        HEAD = (HEAD+1) % SIZE; \
-        return STATUS_OK; \
-    } while (0)
-
-#define UTILS_INCREMENT_BUFFER_TAIL(TAIL, HEAD, SIZE) \
-    do { \
-        /* check if buffer tail is allowed to increment */ \
-        if (TAIL != HEAD) { \
-            TAIL = (TAIL+1) % SIZE; \
-            return STATUS_OK; \
-        } \
-        return STATUS_FAIL; \
-    } while (0)
-
 // seach for the end of a string depending on a given terminator
 #define UTILS_SEARCH_FOR_END_OF_STRING(str, index, terminator) \
     do { \
@@ -45,12 +34,20 @@ typedef struct UtilsNode {
 
 /* Function prototypes */
 uint8_t utils_read_float(char *line, uint8_t *char_counter, float *float_ptr);
-io_status_t utils_increment_buffer_head(utils_ring_buffer_t *buffer);
-io_status_t utils_increment_buffer_tail(utils_ring_buffer_t *buffer);
-io_status_t utils_is_buffer_empty(utils_ring_buffer_t *buffer);
-io_status_t utils_is_buffer_full(utils_ring_buffer_t *buffer);
-io_status_t utils_append_to_buffer(utils_ring_buffer_t *buffer, char *data, uint8_t len);
-io_status_t utils_pop_from_buffer(utils_ring_buffer_t *buffer, char *data);
+uint8_t utils_utoa(uint32_t value, char *str);
+uint8_t utils_itoa(int32_t value, char *str);
+io_status_t utils_ring_init(utils_ring_t *ring, uint8_t *buffer, uint32_t size);
+void utils_ring_reset(utils_ring_t *ring);
+uint32_t utils_ring_used(const utils_ring_t *ring);
+uint32_t utils_ring_space(const utils_ring_t *ring);
+bool utils_ring_is_empty(const utils_ring_t *ring);
+uint32_t utils_ring_push(utils_ring_t *ring, const uint8_t *data, uint32_t length);
+uint32_t utils_ring_pop(utils_ring_t *ring, uint8_t *data, uint32_t length);
+uint8_t utils_ring_peek(const utils_ring_t *ring, uint32_t offset);
+uint32_t utils_ring_read_span(const utils_ring_t *ring, const uint8_t **data);
+void utils_ring_consume(utils_ring_t *ring, uint32_t length);
+uint32_t utils_ring_write_span(const utils_ring_t *ring, uint8_t **data);
+void utils_ring_commit(utils_ring_t *ring, uint32_t length);
 io_status_t utils_free_node(utils_node_t *node);
 io_status_t utils_append_node(utils_node_t *node, utils_node_t *head);
 io_status_t utils_remove_node(utils_node_t *node, utils_node_t *head);
@@ -1,11 +1,26 @@
 #ifndef __WS28XX_GPIO_H
 #define __WS28XX_GPIO_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/devicetree.h>
+
+#define WS28XX_LED_NODE DT_NODELABEL(led_strip)
+
+#if DT_NODE_HAS_PROP(WS28XX_LED_NODE, chain_length)
+#define WS28XX_LED_COUNT DT_PROP(WS28XX_LED_NODE, chain_length) // number of LEDs of the strip
+#else
+#error Unable to determine length of LED strip
+#endif
 
 /* Public Function Prototype */
 int ws28xx_led_init(void);
 int ws28xx_led_set_color(uint8_t r, uint8_t g, uint8_t b, uint16_t led);
 int ws28xx_led_set_color_all(uint8_t r, uint8_t g, uint8_t b);
+int ws28xx_led_set_range(uint16_t start, uint16_t count, uint8_t r, uint8_t g, uint8_t b, bool refresh);
+int ws28xx_led_set_list(uint16_t start, const uint32_t *colors, uint16_t count, bool refresh);
+int ws28xx_led_update(void);
+uint16_t ws28xx_led_count(void);
 int ws28xx_led_get_color(uint8_t *r, uint8_t *g, uint8_t *b, uint16_t led);
 
 #endif
\ No newline at end of file
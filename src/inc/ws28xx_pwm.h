@@ -1,6 +1,7 @@
 #ifndef WS28XX_PWM_H
 #define WS28XX_PWM_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "stm32f7xx_hal.h"
 
@@ -77,6 +78,8 @@ void ws28xx_pwm_init(TIM_HandleTypeDef *_htim, uint32_t _tim_channel);
 HAL_StatusTypeDef ws28xx_pwm_set_color(uint8_t r, uint8_t g, uint8_t b, uint16_t led);
 void ws28xx_pwm_set_color_all(uint8_t r, uint8_t g, uint8_t b);
 void ws28xx_pwm_set_color_all_off(void);
+HAL_StatusTypeDef ws28xx_pwm_set_range(uint16_t start, uint16_t count, uint8_t r, uint8_t g, uint8_t b, bool refresh);
+HAL_StatusTypeDef ws28xx_pwm_set_list(uint16_t start, const uint32_t *colors, uint16_t count, bool refresh);
 HAL_StatusTypeDef ws28xx_pwm_update(void);
 void ws28xx_pwm_dma_half_complete_callback(void);
 void ws28xx_pwm_dma_complete_callback(void);
@@ -86,7 +89,11 @@ int ws28xx_pwm_get_color(uint8_t *r, uint8_t *g, uint8_t *b, uint16_t led);
 #define ws28xx_led_set_color(r, g, b, led) ws28xx_pwm_set_color(r, g, b, led)
 #define ws28xx_led_set_color_all(r, g, b) ws28xx_pwm_set_color_all(r, g, b)
 #define ws28xx_led_set_color_all_off() ws28xx_pwm_set_color_all_off()
+#define ws28xx_led_set_range(start, count, r, g, b, refresh) ws28xx_pwm_set_range(start, count, r, g, b, refresh)
+#define ws28xx_led_set_list(start, colors, count, refresh) ws28xx_pwm_set_list(start, colors, count, refresh)
 #define ws28xx_led_update() ws28xx_pwm_update()
+#define ws28xx_led_count() NUMBER_OF_LEDS
+#define WS28XX_LED_COUNT NUMBER_OF_LEDS
 #define ws28xx_led_get_color(r, g, b, led) ws28xx_pwm_get_color(r, g, b, led)
 
 #endif // WS28XX_PWM_H
\ No newline at end of file
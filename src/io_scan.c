@@ -0,0 +1,251 @@
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(io_scan, LOG_LEVEL_DBG);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "stm32f7xx_remote_io.h"
+#include "io_scan.h"
+#include "digital_input.h"
+#include "digital_output.h"
+#include "digital_reflex.h"
+
+/* private functions */
+static void io_scan_task(void *p1, void *p2, void *p3);
+static void io_scan_tick(struct k_timer *timer);
+
+/* variables */
+static atomic_t scanPeriod = ATOMIC_INIT(0); // cycle period in us, 0 if stopped
+
+// output writes queued for the next cycle
+static struct k_spinlock queueLock;
+static uint32_t queueMask = 0;
+static uint32_t queueData = 0;
+
+// statistics and process image, written by the task and read by the API
+static struct k_spinlock statisticsLock;
+static io_scan_statistics_t statistics;
+static uint64_t cycleTotal = 0; // sum of the cycle times in cycles of the cycle counter
+static io_scan_image_t scanImage;
+
+// state only used by the task
+static uint32_t lastStart = 0; // cycle counter at the start of the last cycle
+static bool lastStartValid = false; // the jitter is measured from the second cycle
+// set by io_scan_start, the task measures the jitter of a new run from its second cycle again
+static atomic_t scanRestarted = ATOMIC_INIT(0);
+
+static const uint32_t jitterBuckets[IO_SCAN_JITTER_BUCKET_COUNT] = IO_SCAN_JITTER_BUCKETS;
+
+K_SEM_DEFINE(io_scan_tick_sem, 0, K_SEM_MAX_LIMIT);
+K_TIMER_DEFINE(io_scan_timer, io_scan_tick, NULL);
+
+// statically define a task for the scan cycles, preempting the digital input task
+K_KERNEL_THREAD_DEFINE(io_scan_thread, 1024,
+		       io_scan_task, NULL, NULL, NULL,
+		       CONFIG_REMOTEIO_SERVICE_PRIORITY - 2, 0, 0);
+
+// start a cycle, called by the timer in interrupt context
+static void io_scan_tick(struct k_timer *timer)
+{
+	k_sem_give(&io_scan_tick_sem);
+}
+
+// write the queued outputs with one write and empty the queue
+static void io_scan_apply_queue(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&queueLock);
+	uint32_t mask = queueMask;
+	uint32_t data = queueData;
+	queueMask = 0;
+	queueData = 0;
+	k_spin_unlock(&queueLock, key);
+
+	if (mask != 0 && digital_output_write_masked(mask, data) < 0) {
+		LOG_ERR("Failed to write the queued outputs");
+	}
+}
+
+// add the timing of a cycle to the statistics
+static void io_scan_measure(uint32_t start, uint32_t end, uint32_t missed, uint32_t period)
+{
+	uint32_t cycle_time = k_cyc_to_us_floor32(end - start);
+	uint32_t jitter = 0;
+
+	// the engine was restarted during the cycle, it belongs to the previous run
+	if (atomic_get(&scanRestarted)) {
+		return;
+	}
+
+	if (lastStartValid) {
+		// deviation of the time since the last cycle from the period, missed ticks excluded
+		int64_t interval = k_cyc_to_us_floor32(start - lastStart);
+		int64_t expected = (int64_t)period * (missed + 1);
+		jitter = (uint32_t)MIN(interval > expected ? interval - expected : expected - interval, UINT32_MAX);
+	}
+	lastStart = start;
+
+	k_spinlock_key_t key = k_spin_lock(&statisticsLock);
+	if (statistics.cycles == 0 || cycle_time < statistics.cycle_min) {
+		statistics.cycle_min = cycle_time;
+	}
+	statistics.cycle_max = MAX(statistics.cycle_max, cycle_time);
+	statistics.cycles++;
+	statistics.overruns += missed;
+	cycleTotal += end - start;
+	if (lastStartValid) {
+		statistics.jitter_max = MAX(statistics.jitter_max, jitter);
+		uint8_t bucket = 0;
+		while (jitter >= jitterBuckets[bucket] && bucket < IO_SCAN_JITTER_BUCKET_COUNT - 1) {
+			bucket++;
+		}
+		statistics.jitter[bucket]++;
+	}
+	k_spin_unlock(&statisticsLock, key);
+
+	lastStartValid = true;
+}
+
+/**
+ * @brief   task running one scan cycle per tick of the timer
+ *          each cycle samples all inputs at once, applies the queued output writes at once,
+ *          evaluates the reflex rules on the debounced inputs and publishes the process image
+ */
+static void io_scan_task(void *p1, void *p2, void *p3)
+{
+	uint32_t previous_inputs = 0;
+
+	for (;;) {
+		k_sem_take(&io_scan_tick_sem, K_FOREVER);
+		uint32_t start = k_cycle_get_32();
+
+		uint32_t period = (uint32_t)atomic_get(&scanPeriod);
+		if (period == 0) {
+			lastStartValid = false;
+			continue;
+		}
+
+		// ticks given while the last cycle was still running are missed cycles
+		uint32_t missed = k_sem_count_get(&io_scan_tick_sem);
+		k_sem_reset(&io_scan_tick_sem);
+		if (atomic_clear(&scanRestarted)) {
+			lastStartValid = false;
+			missed = 0;
+		}
+
+		// snapshot of all inputs
+		uint32_t inputs = digital_input_read_all();
+
+		// apply the output writes queued since the last cycle together
+		io_scan_apply_queue();
+
+		// local rules react within the cycle, on the same debounced inputs as without the scan engine
+		uint32_t now = k_uptime_get_32();
+		digital_reflex_evaluate(digital_input_debounce(inputs, now), now);
+
+		// publish the process image, subscribers are notified by the digital input task
+		k_spinlock_key_t key = k_spin_lock(&statisticsLock);
+		scanImage.cycle++;
+		scanImage.inputs = inputs;
+		scanImage.outputs = digital_output_read_all();
+		k_spin_unlock(&statisticsLock, key);
+		if (inputs != previous_inputs) {
+			previous_inputs = inputs;
+			digital_input_wake_up();
+		}
+
+		io_scan_measure(start, k_cycle_get_32(), missed, period);
+	}
+}
+
+/**
+ * @brief   start the scan engine, or change its period
+ * @param   period  cycle period in us
+ * @return  STATUS_ERROR if the period is out of range
+ */
+io_status_t io_scan_start(uint32_t period)
+{
+	if (period < IO_SCAN_PERIOD_MIN || period > IO_SCAN_PERIOD_MAX) {
+		return STATUS_ERROR;
+	}
+
+	k_timer_stop(&io_scan_timer);
+	atomic_set(&scanRestarted, 1);
+	io_scan_reset_statistics();
+	k_spinlock_key_t key = k_spin_lock(&queueLock);
+	atomic_set(&scanPeriod, (atomic_val_t)period);
+	k_spin_unlock(&queueLock, key);
+	// the reflex rules are evaluated by the scan cycles instead of the digital input task
+	digital_input_wake_up();
+	k_timer_start(&io_scan_timer, K_USEC(period), K_USEC(period));
+
+	LOG_INF("Scan engine started, period %u us", period);
+	return STATUS_OK;
+}
+
+// stop the scan engine, the queued output writes are applied at once
+void io_scan_stop(void)
+{
+	k_timer_stop(&io_scan_timer);
+	// a write seeing the engine running has queued its data before the period is cleared
+	k_spinlock_key_t key = k_spin_lock(&queueLock);
+	atomic_set(&scanPeriod, 0);
+	k_spin_unlock(&queueLock, key);
+	digital_input_wake_up();
+	io_scan_apply_queue();
+}
+
+bool io_scan_is_running(void)
+{
+	return atomic_get(&scanPeriod) != 0;
+}
+
+/**
+ * @brief   write outputs in step with the scan cycles
+ *          while the scan engine runs, the write is queued and applied at the start of the next cycle
+ *          together with the other writes queued meanwhile, a later write of an output replaces an earlier one;
+ *          otherwise the outputs are written at once
+ * @param   mask  bit mask of the outputs to write
+ * @param   data  state of the outputs, 1/active, 0/inactive
+ * @return  0 on success, a negative errno code otherwise
+ */
+int io_scan_write(uint32_t mask, uint32_t data)
+{
+	if ((mask & ~BIT_MASK(DIGITAL_OUTPUT_MAX)) != 0) {
+		return -EINVAL;
+	}
+
+	// the engine state is checked under the lock it is stopped with, so a queued write is never left behind
+	k_spinlock_key_t key = k_spin_lock(&queueLock);
+	bool running = io_scan_is_running();
+	if (running) {
+		queueData = (queueData & ~mask) | (data & mask);
+		queueMask |= mask;
+	}
+	k_spin_unlock(&queueLock, key);
+
+	return running ? 0 : digital_output_write_masked(mask, data);
+}
+
+void io_scan_get_statistics(io_scan_statistics_t *result)
+{
+	k_spinlock_key_t key = k_spin_lock(&statisticsLock);
+	*result = statistics;
+	result->period = (uint32_t)atomic_get(&scanPeriod);
+	result->cycle_avg = (statistics.cycles != 0) ? k_cyc_to_us_floor32(cycleTotal / statistics.cycles) : 0;
+	k_spin_unlock(&statisticsLock, key);
+}
+
+void io_scan_reset_statistics(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&statisticsLock);
+	memset(&statistics, 0, sizeof(statistics));
+	cycleTotal = 0;
+	k_spin_unlock(&statisticsLock, key);
+}
+
+void io_scan_get_image(io_scan_image_t *image)
+{
+	k_spinlock_key_t key = k_spin_lock(&statisticsLock);
+	*image = scanImage;
+	k_spin_unlock(&statisticsLock, key);
+}
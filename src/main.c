@@ -5,6 +5,7 @@ LOG_MODULE_REGISTER(main, LOG_LEVEL_DBG);
 #include "ethernet_if.h"
 #include "digital_input.h"
 #include "digital_output.h"
+#include "digital_reflex.h"
 #include "flash.h"
 #include "settings.h"
 #include "uart.h"
@@ -30,6 +31,9 @@ int main(void) {
     // initialize digital output
     digital_output_init();
 
+    // load the reflex rules of the inputs and outputs
+    digital_reflex_init();
+
     // initialize UART
     uart_init();
 
@@ -17,6 +17,9 @@ extern struct k_event flashAreaReadyEvent;
 
 settings_t settings;
 
+// size of a record of settings version 1, which ends before the debounce times
+#define SETTINGS_V1_SIZE ROUND_UP(offsetof(settings_t, debounce), __alignof__(settings_t))
+
 const settings_t defaults = {
     .settings_version = SETTINGS_VERSION,
     .ip_address_0 = 192,
@@ -57,6 +60,7 @@ const settings_t defaults = {
     .pwmws288xx_1 = {
         .number_of_leds = 25,
     },
+    .debounce = { 0 },
 };
 
 /* Private functions */
@@ -113,15 +117,25 @@ io_status_t settings_save()
 
 io_status_t settings_load()
 {
-    if (flash_read_data_with_checksum(FLASH_SECTOR_SETTINGS, (uint8_t *)&settings, sizeof(settings_t)) != STATUS_OK)
+    if (flash_read_data_with_checksum(FLASH_SECTOR_SETTINGS, (uint8_t *)&settings, sizeof(settings_t)) == STATUS_OK &&
+        settings.settings_version == SETTINGS_VERSION)
     {
-        return STATUS_ERROR;
+        return STATUS_OK;
     }
 
-    if (settings.settings_version != SETTINGS_VERSION)
+    // migrate settings of version 1, e.g. after an OTA update, so the device keeps its network settings
+    if (flash_read_data_with_checksum(FLASH_SECTOR_SETTINGS, (uint8_t *)&settings, SETTINGS_V1_SIZE) == STATUS_OK &&
+        settings.settings_version == 1)
     {
-        return STATUS_ERROR;
+        memcpy(settings.debounce, defaults.debounce, sizeof(settings.debounce));
+        settings.settings_version = SETTINGS_VERSION;
+        LOG_INF("Settings migrated from version 1");
+        if (settings_save() != STATUS_OK)
+        {
+            LOG_ERR("Failed to save the migrated settings");
+        }
+        return STATUS_OK;
     }
 
-    return STATUS_OK;
+    return STATUS_ERROR;
 }
\ No newline at end of file
@@ -1,18 +1,42 @@
+#include <string.h>
 #include <app_version.h>
 #include "stm32f7xx_remote_io.h"
 #include "system_info.h"
+#include "utils.h"
 #include "uart.h"
 
+// maximum length of a line with a value, e.g. "  Digital Inputs: 16\r\n"
+#define SYSTEM_INFO_LINE_MAX_LENGTH 64
+
+// print a line "<Label><Value>\r\n"
+static void system_info_print_value(void *user_data, system_info_callback_fn_t cb, const char *label, int32_t value)
+{
+    char line[SYSTEM_INFO_LINE_MAX_LENGTH];
+    uint16_t length = strlen(label);
+
+    memcpy(line, label, length);
+    length += utils_itoa(value, line + length);
+    line[length++] = '\r';
+    line[length++] = '\n';
+    cb(user_data, line, length);
+}
+
+// print a line of text without a value
+static void system_info_print_text(void *user_data, system_info_callback_fn_t cb, const char *text)
+{
+    cb(user_data, text, strlen(text));
+}
+
 void system_info_print(void *user_data, system_info_callback_fn_t cb)
 {
     // print system info
-    cb(user_data, "Firmware: %s\r\n", APP_VERSION_EXTENDED_STRING);
-    cb(user_data, "Commands:\r\n");
-    cb(user_data, "  Read: R<service_id> <param1> <param2> ... <paramN>\r\n");
-    cb(user_data, "  Write: W<service_id> <param1> <param2> ... <paramN>\r\n\r\n");
-    cb(user_data, "System Info:\r\n");
-    cb(user_data, "  Digital Inputs: %d\r\n", DIGITAL_INPUT_MAX);
-    cb(user_data, "  Digital Outputs: %d\r\n", DIGITAL_OUTPUT_MAX);
-    cb(user_data, "  PWM WS28XX Channels: %d\r\n", PWM_WS28XX_LED_MAX-1);
-    cb(user_data, "  UART Channels: %d\r\n", UART_MAX-1);
-}
\ No newline at end of file
+    system_info_print_text(user_data, cb, "Firmware: " APP_VERSION_EXTENDED_STRING "\r\n");
+    system_info_print_text(user_data, cb, "Commands:\r\n");
+    system_info_print_text(user_data, cb, "  Read: R<service_id> <param1> <param2> ... <paramN>\r\n");
+    system_info_print_text(user_data, cb, "  Write: W<service_id> <param1> <param2> ... <paramN>\r\n\r\n");
+    system_info_print_text(user_data, cb, "System Info:\r\n");
+    system_info_print_value(user_data, cb, "  Digital Inputs: ", DIGITAL_INPUT_MAX);
+    system_info_print_value(user_data, cb, "  Digital Outputs: ", DIGITAL_OUTPUT_MAX);
+    system_info_print_value(user_data, cb, "  PWM WS28XX Channels: ", PWM_WS28XX_LED_MAX-1);
+    system_info_print_value(user_data, cb, "  UART Channels: ", UART_MAX-1);
+}
@@ -35,9 +35,13 @@ static listener_t *headListener[UART_MAX] = { NULL };
 
 // mutex lock
 static K_MUTEX_DEFINE(uartLock);
+// mutex locks for writing to each UART
+static struct k_mutex uartTxLock[UART_MAX];
 
-utils_ring_buffer_t uart_rx_buffer[UART_MAX]; // ring buffer for UART RX
-char rxBuffer[UART_MAX][UART_RX_BUFFER_SIZE]; // ring buffer for UART RX
+BUILD_ASSERT(IS_POWER_OF_TWO(UART_RX_BUFFER_SIZE), "UART_RX_BUFFER_SIZE must be a power of two");
+
+utils_ring_t uart_rx_buffer[UART_MAX]; // ring buffer for UART RX, filled by the ISR
+uint8_t rxBuffer[UART_MAX][UART_RX_BUFFER_SIZE]; // storage of the UART RX ring buffers
 static uart_context_t uartContext[UART_MAX]; // UART context
 
 // create a thread for processing RX data
@@ -74,7 +78,7 @@ static void uart_callback(const struct device *dev, void *user_data)
             uartCtx->events |= UART_EVENT_START_RCV;
 
         // append the character to the rx buffer
-        utils_append_to_buffer(uartCtx->rx_buffer, &c, 1);
+        utils_ring_push(uartCtx->rx_buffer, (uint8_t *)&c, 1);
         // check if the character is a new line
         if (c == '\r' || c == '\n')
         {
@@ -95,6 +99,11 @@ void uart_init()
 
     int ret;
     struct uart_config uart_cfg;
+    // initialize the tx locks first, they are used even if a UART fails to be configured
+    for (uint8_t i = 0; i < UART_MAX; i++)
+    {
+        k_mutex_init(&uartTxLock[i]);
+    }
     // configure UART devices
     for (uint8_t i = 0; i < UART_MAX; i++)
     {
@@ -116,6 +125,10 @@ void uart_init()
             LOG_ERR("Failed to configure UART%d: %d\n", i, ret);
             return;
         }
+        // intialize uart context before the rx interrupt may use it
+        uartContext[i].rx_buffer = &uart_rx_buffer[i];
+        utils_ring_init(uartContext[i].rx_buffer, &rxBuffer[i][0], UART_RX_BUFFER_SIZE);
+        uartContext[i].events = 0;
         // set uart irq and callback to receive data
         if ((ret =uart_irq_callback_user_data_set(uart_dev[i], &uart_callback, &uartContext[i])) < 0)
         {
@@ -124,14 +137,6 @@ void uart_init()
         }
         // enable UART RX interrupt
         uart_irq_rx_enable(uart_dev[i]);
-
-        // intialize uart context
-        uartContext[i].rx_buffer = &uart_rx_buffer[i];
-        uartContext[i].rx_buffer->buffer = &rxBuffer[i][0];
-        uartContext[i].rx_buffer->size = UART_RX_BUFFER_SIZE;
-        uartContext[i].rx_buffer->head = 0;
-        uartContext[i].rx_buffer->tail = 0;
-        uartContext[i].events = 0;
     }
 }
 
@@ -161,35 +166,40 @@ void uart_process_rx(void *parameters)
             // tx buffer
             char txBuffer[UART_TX_BUFFER_SIZE] = {'\0'};
             volatile uint8_t txBuffIndex = 0;
-            char c;
-            while (utils_pop_from_buffer(uartCtx.rx_buffer, &c) == STATUS_OK)
+            uint8_t chunk[16];
+            uint32_t count;
+            while ((count = utils_ring_pop(uartCtx.rx_buffer, chunk, sizeof(chunk))) > 0)
             {
-                // check if the character is a new line
-                if (c == '\r' || c == '\n')
+                for (uint32_t n = 0; n < count; n++)
                 {
-                    if (txBuffIndex == 0) continue; // skip empty lines
-                    
-                    // execute the callback function
-                    listener_t *current = headListener[i];
-                    while (current != NULL)
+                    char c = chunk[n];
+                    // check if the character is a new line
+                    if (c == '\r' || c == '\n')
                     {
-                        // check if the callback is not NULL
-                        if (current->cb == NULL)
+                        if (txBuffIndex == 0) continue; // skip empty lines
+                    
+                        // execute the callback function
+                        listener_t *current = headListener[i];
+                        while (current != NULL)
                         {
-                            LOG_ERR("Callback is NULL\n");
-                            break;
+                            // check if the callback is not NULL
+                            if (current->cb == NULL)
+                            {
+                                LOG_ERR("Callback is NULL\n");
+                                break;
+                            }
+                            current->cb(current->user_data, txBuffer, txBuffIndex, i);
+                            current = current->next;
+                            LOG_HEXDUMP_DBG(txBuffer, txBuffIndex, "UART RX");
                         }
-                        current->cb(current->user_data, txBuffer, txBuffIndex, i);
-                        current = current->next;
-                        LOG_HEXDUMP_DBG(txBuffer, txBuffIndex, "UART RX");
+                        // reset the tx buffer
+                        txBuffIndex = 0;
+                    }
+                    else
+                    {
+                        if ((txBuffIndex+1) <= UART_TX_BUFFER_SIZE)
+                            txBuffer[txBuffIndex++] = c;
                     }
-                    // reset the tx buffer
-                    txBuffIndex = 0;
-                }
-                else
-                {
-                    if ((txBuffIndex+1) <= UART_TX_BUFFER_SIZE)
-                        txBuffer[txBuffIndex++] = c;
                 }
             }
         }
@@ -199,7 +209,7 @@ void uart_process_rx(void *parameters)
     }
 }
 
-int uart_printf(uart_index_t uart_index, const uint8_t *data, uint8_t len)
+int uart_printf(uart_index_t uart_index, const uint8_t *data, uint16_t len)
 {
     // assert if uart index is valid
     if (uart_index >= UART_MAX)
@@ -207,10 +217,13 @@ int uart_printf(uart_index_t uart_index, const uint8_t *data, uint8_t len)
         return STATUS_ERROR;
     }
 
-    for (uint8_t i = 0; i < len; i++)
+    // a message is written as a whole, messages to different UARTs do not wait for each other
+    k_mutex_lock(&uartTxLock[uart_index], K_FOREVER);
+    for (uint16_t i = 0; i < len; i++)
     {
         uart_poll_out(uart_dev[uart_index], data[i]);
     }
+    k_mutex_unlock(&uartTxLock[uart_index]);
 
     LOG_HEXDUMP_DBG(data, len, "UART TX");
 
@@ -1,3 +1,5 @@
+#include <string.h>
+#include <zephyr/sys/util.h>
 #include "stm32f7xx_remote_io.h"
 
 // Extracts a floating point value from a string. The following code is based loosely on
@@ -88,87 +90,168 @@ uint8_t utils_read_float(char *line, uint8_t *char_counter, float *float_ptr)
 	return (true);
 }
 
-/* Functions to manipulate ring buffer */
-// increment the head of the ring buffer
-io_status_t utils_increment_buffer_head(utils_ring_buffer_t *buffer)
+// Converts an unsigned integer to decimal digits without a null terminator.
+// str must have room for MAX_INT_DIGITS characters, returns the number of digits written.
+uint8_t utils_utoa(uint32_t value, char *str)
 {
-	if (buffer == NULL) {
-		return STATUS_FAIL;
+	char digits[MAX_INT_DIGITS];
+	uint8_t ndigit = 0;
+
+	// extract the digits from the least significant one
+	do {
+		digits[ndigit++] = '0' + (value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	// write them in reverse order
+	for (uint8_t i = 0; i < ndigit; i++) {
+		str[i] = digits[ndigit - 1 - i];
 	}
 
-	UTILS_INCREMENT_BUFFER_HEAD(buffer->head, buffer->tail, buffer->size);
+	return ndigit;
 }
 
-// increment the tail of the ring buffer
-io_status_t utils_increment_buffer_tail(utils_ring_buffer_t *buffer)
+// Converts a signed integer to decimal digits without a null terminator.
+// str must have room for MAX_INT_DIGITS + 1 characters, returns the number of characters written.
+uint8_t utils_itoa(int32_t value, char *str)
 {
-	if (buffer == NULL) {
-		return STATUS_FAIL;
+	if (value < 0) {
+		str[0] = '-';
+		// negate in unsigned arithmetic, so INT32_MIN does not overflow
+		return 1 + utils_utoa(0U - (uint32_t)value, str + 1);
 	}
 
-	UTILS_INCREMENT_BUFFER_TAIL(buffer->tail, buffer->head, buffer->size);
+	return utils_utoa((uint32_t)value, str);
 }
 
-// check if the ring buffer is empty
-io_status_t utils_is_buffer_empty(utils_ring_buffer_t *buffer)
+/* Functions to manipulate the SPSC ring buffer */
+// initialize the ring buffer, the size must be a power of two
+io_status_t utils_ring_init(utils_ring_t *ring, uint8_t *buffer, uint32_t size)
 {
-	if (buffer == NULL) {
-		return STATUS_FAIL;
+	if (ring == NULL || buffer == NULL || !IS_POWER_OF_TWO(size)) {
+		return STATUS_ERROR;
 	}
 
-	return (buffer->head == buffer->tail) ? STATUS_OK : STATUS_FAIL;
+	ring->buffer = buffer;
+	ring->mask = size - 1;
+	atomic_set(&ring->head, 0);
+	atomic_set(&ring->tail, 0);
+
+	return STATUS_OK;
 }
 
-// check if the ring buffer is full
-io_status_t utils_is_buffer_full(utils_ring_buffer_t *buffer)
+// drop all the data, neither the producer nor the consumer may use the ring meanwhile
+void utils_ring_reset(utils_ring_t *ring)
 {
-	if (buffer == NULL) {
-		return STATUS_FAIL;
-	}
+	atomic_set(&ring->head, 0);
+	atomic_set(&ring->tail, 0);
+}
 
-	return (((buffer->head + 1) % buffer->size) == buffer->tail) ? STATUS_OK : STATUS_FAIL;
+// number of bytes which can be popped
+uint32_t utils_ring_used(const utils_ring_t *ring)
+{
+	return (uint32_t)atomic_get(&ring->head) - (uint32_t)atomic_get(&ring->tail);
 }
 
-// append data to the ring buffer
-io_status_t utils_append_to_buffer(utils_ring_buffer_t *buffer, char *data, uint8_t len)
+// number of bytes which can be pushed
+uint32_t utils_ring_space(const utils_ring_t *ring)
 {
-	if (buffer == NULL || data == NULL) {
-		return STATUS_FAIL;
-	}
+	return ring->mask + 1 - utils_ring_used(ring);
+}
+
+// check if the ring buffer is empty
+bool utils_ring_is_empty(const utils_ring_t *ring)
+{
+	return atomic_get(&ring->head) == atomic_get(&ring->tail);
+}
+
+// get the contiguous free space at the head, called by the producer only
+uint32_t utils_ring_write_span(const utils_ring_t *ring, uint8_t **data)
+{
+	uint32_t head = (uint32_t)atomic_get(&ring->head);
+	uint32_t index = head & ring->mask;
+
+	*data = &ring->buffer[index];
+	return MIN(utils_ring_space(ring), ring->mask + 1 - index);
+}
+
+// publish bytes written into the write span, called by the producer only
+void utils_ring_commit(utils_ring_t *ring, uint32_t length)
+{
+	// the data must be written before the head is moved
+	atomic_set(&ring->head, (atomic_val_t)((uint32_t)atomic_get(&ring->head) + length));
+}
+
+// get the contiguous data at the tail, called by the consumer only
+uint32_t utils_ring_read_span(const utils_ring_t *ring, const uint8_t **data)
+{
+	uint32_t tail = (uint32_t)atomic_get(&ring->tail);
+	uint32_t index = tail & ring->mask;
+
+	*data = &ring->buffer[index];
+	return MIN(utils_ring_used(ring), ring->mask + 1 - index);
+}
+
+// release bytes at the tail, called by the consumer only
+void utils_ring_consume(utils_ring_t *ring, uint32_t length)
+{
+	length = MIN(length, utils_ring_used(ring));
+	// the data must be read before the tail is moved
+	atomic_set(&ring->tail, (atomic_val_t)((uint32_t)atomic_get(&ring->tail) + length));
+}
 
-	// check if the buffer is full
-	if (utils_is_buffer_full(buffer) == STATUS_OK) {
-		return STATUS_FAIL;
+// read a byte at the given offset from the tail without popping it,
+// the offset must be less than utils_ring_used(), called by the consumer only
+uint8_t utils_ring_peek(const utils_ring_t *ring, uint32_t offset)
+{
+	return ring->buffer[((uint32_t)atomic_get(&ring->tail) + offset) & ring->mask];
+}
+
+// push as many bytes as fit into the ring buffer, return the number of bytes pushed
+// note: the data is copied in at most two segments, no data is overwritten
+uint32_t utils_ring_push(utils_ring_t *ring, const uint8_t *data, uint32_t length)
+{
+	uint8_t *span;
+	uint32_t pushed = 0;
+
+	if (ring == NULL || data == NULL) {
+		return 0;
 	}
 
-	// append data to the buffer
-    // note: if the data length is greater than the rest of the buffer size, then
-    // new data will overwrite the old data.
-	for (uint8_t i = 0; i < len; i++) {
-		buffer->buffer[buffer->head] = data[i];
-		utils_increment_buffer_head(buffer);
+	for (uint8_t segment = 0; segment < 2 && pushed < length; segment++) {
+		uint32_t count = MIN(utils_ring_write_span(ring, &span), length - pushed);
+		if (count == 0) {
+			break;
+		}
+		memcpy(span, data + pushed, count);
+		pushed += count;
+		utils_ring_commit(ring, count);
 	}
 
-	return STATUS_OK;
+	return pushed;
 }
 
-// pop data from the ring buffer
-io_status_t utils_pop_from_buffer(utils_ring_buffer_t *buffer, char *data)
+// pop up to length bytes from the ring buffer, return the number of bytes popped
+uint32_t utils_ring_pop(utils_ring_t *ring, uint8_t *data, uint32_t length)
 {
-    if (buffer == NULL || data == NULL) {
-        return STATUS_FAIL;
-    }
+	const uint8_t *span;
+	uint32_t popped = 0;
 
-    // check if the buffer is empty
-    if (utils_is_buffer_empty(buffer) == STATUS_OK) {
-        return STATUS_FAIL;
-    }
+	if (ring == NULL || data == NULL) {
+		return 0;
+	}
 
-    // pop data from the buffer
-    *data = buffer->buffer[buffer->tail];
-    utils_increment_buffer_tail(buffer);
+	for (uint8_t segment = 0; segment < 2 && popped < length; segment++) {
+		uint32_t count = MIN(utils_ring_read_span(ring, &span), length - popped);
+		if (count == 0) {
+			break;
+		}
+		memcpy(data + popped, span, count);
+		popped += count;
+		utils_ring_consume(ring, count);
+	}
 
-    return STATUS_OK;
+	return popped;
 }
 
 io_status_t utils_free_node(utils_node_t *node)
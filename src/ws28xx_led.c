@@ -6,14 +6,9 @@ LOG_MODULE_REGISTER(ws28xx_led_strip, LOG_LEVEL_DBG);
 #include <zephyr/drivers/led_strip.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/device.h>
+#include "ws28xx_led.h"
 
-#define LED_STRIP_NODE DT_NODELABEL(led_strip)
-
-#if DT_NODE_HAS_PROP(LED_STRIP_NODE, chain_length)
-#define STRIP_NUM_PIXELS	DT_PROP(LED_STRIP_NODE, chain_length)
-#else
-#error Unable to determine length of LED strip
-#endif
+#define STRIP_NUM_PIXELS	WS28XX_LED_COUNT
 
 // store the rgb values for each pixel
 static struct led_rgb pixels[STRIP_NUM_PIXELS] = { 0 };
@@ -123,6 +118,98 @@ exit:
     return ret;
 }
 
+int ws28xx_led_set_range(uint16_t start, uint16_t count, uint8_t r, uint8_t g, uint8_t b, bool refresh)
+{
+    int ret = 0;
+
+    // check if the LED range is valid
+    if (count == 0 || start >= STRIP_NUM_PIXELS || count > STRIP_NUM_PIXELS - start) {
+        return -1;
+    }
+
+    // lock the mutex
+    k_mutex_lock(&led_strip_mutex, K_FOREVER);
+    // set the color of the LEDs in the range
+    for (int i = start; i < start + count; i++) {
+        pixels[i].r = r;
+        pixels[i].g = g;
+        pixels[i].b = b;
+    }
+
+    // update the LED strip once for the whole range
+    if (refresh) {
+        ret = led_strip_update_rgb(led_strip_dev, pixels, STRIP_NUM_PIXELS);
+        if (ret < 0) {
+            LOG_ERR("Failed to update LED strip [%d..%d]: %d", start, start + count - 1, ret);
+            goto exit;
+        }
+    }
+
+exit:
+    // unlock the mutex
+    k_mutex_unlock(&led_strip_mutex);
+
+    return ret;
+}
+
+int ws28xx_led_set_list(uint16_t start, const uint32_t *colors, uint16_t count, bool refresh)
+{
+    int ret = 0;
+
+    // check if the LED range is valid
+    if (count == 0 || start >= STRIP_NUM_PIXELS || count > STRIP_NUM_PIXELS - start) {
+        return -1;
+    }
+
+    // lock the mutex
+    k_mutex_lock(&led_strip_mutex, K_FOREVER);
+    // set the color of each LED, colors are packed as 0xRRGGBB
+    for (int i = 0; i < count; i++) {
+        pixels[start + i].r = (uint8_t)(colors[i] >> 16);
+        pixels[start + i].g = (uint8_t)(colors[i] >> 8);
+        pixels[start + i].b = (uint8_t)colors[i];
+    }
+
+    // update the LED strip once for the whole list
+    if (refresh) {
+        ret = led_strip_update_rgb(led_strip_dev, pixels, STRIP_NUM_PIXELS);
+        if (ret < 0) {
+            LOG_ERR("Failed to update LED strip [%d..%d]: %d", start, start + count - 1, ret);
+            goto exit;
+        }
+    }
+
+exit:
+    // unlock the mutex
+    k_mutex_unlock(&led_strip_mutex);
+
+    return ret;
+}
+
+int ws28xx_led_update(void)
+{
+    int ret = 0;
+
+    // lock the mutex
+    k_mutex_lock(&led_strip_mutex, K_FOREVER);
+
+    // send the staged pixels to the LED strip
+    ret = led_strip_update_rgb(led_strip_dev, pixels, STRIP_NUM_PIXELS);
+    if (ret < 0) {
+        LOG_ERR("Failed to update LED strip: %d", ret);
+    }
+
+    // unlock the mutex
+    k_mutex_unlock(&led_strip_mutex);
+
+    return ret;
+}
+
+uint16_t ws28xx_led_count(void)
+{
+    return STRIP_NUM_PIXELS;
+}
+
 int ws28xx_led_get_color(uint8_t *r, uint8_t *g, uint8_t *b, uint16_t led)
 {
     // check if the LED index is valid
@@ -87,6 +87,39 @@ void ws28xx_pwm_set_color_all_off(void)
     ws28xx_pwm_set_color_all(0, 0, 0);
 }
 
+HAL_StatusTypeDef ws28xx_pwm_set_range(uint16_t start, uint16_t count, uint8_t r, uint8_t g, uint8_t b, bool refresh)
+{
+    // check if the LED range is valid
+    if (count == 0 || start >= NUMBER_OF_LEDS || count > NUMBER_OF_LEDS - start)
+    {
+        return HAL_ERROR;
+    }
+
+    for (uint16_t i = start; i < start + count; i++)
+    {
+        ws28xx_pwm_set_color(r, g, b, i);
+    }
+
+    return refresh ? ws28xx_pwm_update() : HAL_OK;
+}
+
+HAL_StatusTypeDef ws28xx_pwm_set_list(uint16_t start, const uint32_t *colors, uint16_t count, bool refresh)
+{
+    // check if the LED range is valid
+    if (count == 0 || start >= NUMBER_OF_LEDS || count > NUMBER_OF_LEDS - start)
+    {
+        return HAL_ERROR;
+    }
+
+    // colors are packed as 0xRRGGBB
+    for (uint16_t i = 0; i < count; i++)
+    {
+        ws28xx_pwm_set_color((uint8_t)(colors[i] >> 16), (uint8_t)(colors[i] >> 8), (uint8_t)colors[i], start + i);
+    }
+
+    return refresh ? ws28xx_pwm_update() : HAL_OK;
+}
+
 HAL_StatusTypeDef ws28xx_pwm_update(void)
 {
     // check if the DMA transfer is ongoing